@@ -0,0 +1,113 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "whenwords.h"
+
+#define BENCH_ROWS 2000000
+#define BENCH_REFERENCE 1704067200.0
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void bench_report(const char *name, size_t rows, double elapsed) {
+    printf("%-34s %8.1f ns/row %10.2f Mrows/s\n", name, elapsed * 1e9 / (double)rows,
+           (double)rows / elapsed / 1e6);
+}
+
+int main(void) {
+    size_t rows = BENCH_ROWS;
+    ww_timestamp *structs = (ww_timestamp *)malloc(rows * sizeof(*structs));
+    ww_packed_ts *packed = (ww_packed_ts *)malloc(rows * sizeof(*packed));
+    size_t *offsets = (size_t *)malloc((rows + 1) * sizeof(*offsets));
+    if (!structs || !packed || !offsets) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    srand(42);
+    for (size_t i = 0; i < rows; i++) {
+        double age = (double)(rand() % (3 * 365 * 86400));
+        structs[i] = ww_timestamp_from_unix(BENCH_REFERENCE - age);
+    }
+
+    printf("bytes/row: ww_timestamp %zu, ww_packed_ts %zu\n", sizeof(ww_timestamp), sizeof(ww_packed_ts));
+
+    double start = bench_now();
+    size_t valid = ww_timestamp_pack_array(structs, rows, packed);
+    bench_report("ww_timestamp_pack_array", rows, bench_now() - start);
+    if (valid != rows) {
+        fprintf(stderr, "unexpected invalid rows\n");
+        return 1;
+    }
+
+    ww_timestamp reference = ww_timestamp_from_unix(BENCH_REFERENCE);
+    ww_buf buf = ww_buf_init(NULL, 0, realloc);
+    start = bench_now();
+    for (size_t i = 0; i < rows; i++) {
+        offsets[i] = buf.len;
+        timeago_append(&buf, WW_ESCAPE_NONE, structs[i], reference);
+    }
+    bench_report("timeago_append (ww_timestamp)", rows, bench_now() - start);
+
+    buf.len = 0;
+    start = bench_now();
+    timeago_batch(&buf, WW_ESCAPE_NONE, packed, rows, BENCH_REFERENCE, offsets);
+    bench_report("timeago_batch (ww_packed_ts)", rows, bench_now() - start);
+
+    start = bench_now();
+    for (size_t i = 0; i < rows; i++) {
+        free(timeago(structs[i], reference));
+    }
+    bench_report("timeago (malloc per row)", rows, bench_now() - start);
+
+    ww_duration_options options = ww_duration_options_default();
+    buf.len = 0;
+    start = bench_now();
+    for (size_t i = 0; i < rows; i++) {
+        duration_append(&buf, WW_ESCAPE_NONE, BENCH_REFERENCE - packed[i], &options);
+    }
+    bench_report("duration_append", rows, bench_now() - start);
+
+    ww_duration_spec spec = ww_duration_spec_default();
+    ww_duration_plan plan;
+    ww_duration_format_compile(&spec, &plan);
+    buf.len = 0;
+    start = bench_now();
+    for (size_t i = 0; i < rows; i++) {
+        ww_duration_format_exec(&plan, BENCH_REFERENCE - packed[i], &buf);
+    }
+    bench_report("ww_duration_format_exec", rows, bench_now() - start);
+
+    double *ends = (double *)malloc(rows * sizeof(*ends));
+    if (!ends) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for (size_t i = 0; i < rows; i++) {
+        ends[i] = packed[i] + (double)(rand() % (90 * 86400));
+    }
+    buf.len = 0;
+    start = bench_now();
+    for (size_t i = 0; i < rows; i++) {
+        offsets[i] = buf.len;
+        date_range_append(&buf, WW_ESCAPE_NONE, ww_timestamp_from_unix(packed[i]), ww_timestamp_from_unix(ends[i]));
+    }
+    bench_report("date_range_append", rows, bench_now() - start);
+
+    buf.len = 0;
+    start = bench_now();
+    date_range_batch(&buf, WW_ESCAPE_NONE, packed, ends, rows, offsets);
+    bench_report("date_range_batch", rows, bench_now() - start);
+
+    free(ends);
+    free(buf.ptr);
+    free(offsets);
+    free(packed);
+    free(structs);
+    return 0;
+}
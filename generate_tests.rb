@@ -1,15 +1,37 @@
 #!/usr/bin/env ruby
 # frozen_string_literal: true
 
+require 'date'
 require 'yaml'
 
 def c_escape(str)
   str.gsub('\\', '\\\\').gsub('"', '\\"').gsub("\n", "\\n")
 end
 
+def c_double(value)
+  return 'NAN' if value.is_a?(Float) && value.nan?
+  return value.positive? ? 'HUGE_VAL' : '-HUGE_VAL' if value.is_a?(Float) && value.infinite?
+
+  value.to_s
+end
+
+def timestamp_input(value)
+  case value
+  when nil then '{WW_TS_NONE, 0, NULL}'
+  when String then "{WW_TS_ISO, 0, \"#{c_escape(value)}\"}"
+  else "{WW_TS_UNIX, #{c_double(value)}, NULL}"
+  end
+end
+
+def c_date(iso)
+  date = Date.iso8601(iso)
+  "{#{(date - Date.new(1970, 1, 1)).to_i}, #{date.year}, #{date.month}, #{date.day}, #{date.wday}}"
+end
+
 data = YAML.load_file('tests.yaml')
 
 File.open('tests.c', 'w') do |f|
+  f.puts "#include <locale.h>"
   f.puts "#include <math.h>"
   f.puts "#include <stdio.h>"
   f.puts "#include <stdlib.h>"
@@ -57,6 +79,129 @@ File.open('tests.c', 'w') do |f|
   f.puts "    int error;"
   f.puts "} DateRangeTest;"
   f.puts
+  f.puts "typedef struct {"
+  f.puts "    const char *name;"
+  f.puts "    const char *input;"
+  f.puts "    double reference;"
+  f.puts "    double lo;"
+  f.puts "    double hi;"
+  f.puts "    int error;"
+  f.puts "    const char *render;"
+  f.puts "    int human_date;"
+  f.puts "} ParseTimeagoTest;"
+  f.puts
+  f.puts "typedef struct {"
+  f.puts "    const char *name;"
+  f.puts "    double seconds;"
+  f.puts "    unsigned units;"
+  f.puts "    int compact;"
+  f.puts "    int max_units;"
+  f.puts "    int nearest;"
+  f.puts "    const char *separator;"
+  f.puts "    const char *output;"
+  f.puts "    int error;"
+  f.puts "} DurationFormatTest;"
+  f.puts
+
+  f.puts "typedef struct {"
+  f.puts "    const char *name;"
+  f.puts "    int function;"
+  f.puts "    int cached;"
+  f.puts "    double now;"
+  f.puts "    double timestamp;"
+  f.puts "    const char *text;"
+  f.puts "    const char *output;"
+  f.puts "    double lo;"
+  f.puts "    double hi;"
+  f.puts "    int error;"
+  f.puts "} ClockTest;"
+  f.puts
+
+  f.puts "typedef struct {"
+  f.puts "    const char *name;"
+  f.puts "    int function;"
+  f.puts "    ww_escape_mode mode;"
+  f.puts "    const char *prefix;"
+  f.puts "    size_t capacity;"
+  f.puts "    double first;"
+  f.puts "    double second;"
+  f.puts "    const char *output;"
+  f.puts "    int error;"
+  f.puts "} AppendTest;"
+  f.puts
+
+  f.puts "typedef struct {"
+  f.puts "    ww_timestamp_kind kind;"
+  f.puts "    double unix_seconds;"
+  f.puts "    const char *iso;"
+  f.puts "} TimestampInput;"
+  f.puts
+  f.puts "typedef struct {"
+  f.puts "    TimestampInput first;"
+  f.puts "    const char *output;"
+  f.puts "} BatchRow;"
+  f.puts
+  f.puts "typedef struct {"
+  f.puts "    const char *name;"
+  f.puts "    int function;"
+  f.puts "    int has_reference;"
+  f.puts "    double reference;"
+  f.puts "    const BatchRow *rows;"
+  f.puts "    size_t count;"
+  f.puts "    size_t valid;"
+  f.puts "} BatchTest;"
+  f.puts
+  f.puts "#define BATCH_MAX_ROWS 16"
+  f.puts
+
+  f.puts "typedef struct {"
+  f.puts "    const char *name;"
+  f.puts "    int function;"
+  f.puts "    const int64_t *i64;"
+  f.puts "    const double *f64;"
+  f.puts "    const uint8_t *validity;"
+  f.puts "    size_t offset;"
+  f.puts "    size_t length;"
+  f.puts "    int64_t ticks_per_second;"
+  f.puts "    double reference;"
+  f.puts "    const char *const *rows;"
+  f.puts "    int error;"
+  f.puts "} ColumnTest;"
+  f.puts
+  f.puts "#define COLUMN_MAX_ROWS 16"
+  f.puts
+
+  f.puts "typedef struct {"
+  f.puts "    ww_date first;"
+  f.puts "    ww_date last;"
+  f.puts "    const char *label;"
+  f.puts "} CalendarSpan;"
+  f.puts
+  f.puts "typedef struct {"
+  f.puts "    const char *name;"
+  f.puts "    TimestampInput start;"
+  f.puts "    TimestampInput end;"
+  f.puts "    ww_calendar_step step;"
+  f.puts "    size_t label_size;"
+  f.puts "    const CalendarSpan *spans;"
+  f.puts "    size_t count;"
+  f.puts "    int error;"
+  f.puts "} CalendarTest;"
+  f.puts
+
+  f.puts "typedef struct {"
+  f.puts "    const char *name;"
+  f.puts "    const char *prefix;"
+  f.puts "    size_t capacity;"
+  f.puts "    double timestamp;"
+  f.puts "    double reference;"
+  f.puts "    TimestampInput end;"
+  f.puts "    unsigned flags;"
+  f.puts "    const char *views[3];"
+  f.puts "    ww_description expected;"
+  f.puts "    int error;"
+  f.puts "} DescribeTest;"
+  f.puts
 
   f.puts "static const TimeagoTest TIMEAGO_TESTS[] = {"
   data.fetch('timeago', []).each do |t|
@@ -130,6 +275,218 @@ File.open('tests.c', 'w') do |f|
   f.puts "};"
   f.puts
 
+  f.puts "static const ParseDurationTest PARSE_DURATION_GRAMMAR_TESTS[] = {"
+  data.fetch('parse_duration_grammar', []).each do |t|
+    name = c_escape(t['name'])
+    input_str = t['input'] ? "\"#{c_escape(t['input'])}\"" : 'NULL'
+    f.puts "    {\"#{name}\", #{input_str}, #{t['output'] || 0}, #{t['error'] ? 1 : 0}},"
+  end
+  f.puts "};"
+  f.puts
+
+  f.puts "static const ParseDurationTest PARSE_DURATION_NS_TESTS[] = {"
+  data.fetch('parse_duration_ns', []).each do |t|
+    name = c_escape(t['name'])
+    input = t['input']
+    output = t['output']
+    error = t['error'] ? 1 : 0
+    input_str = input ? "\"#{c_escape(input)}\"" : 'NULL'
+    output_val = output ? output : 0
+    f.puts "    {\"#{name}\", #{input_str}, #{output_val}.0, #{error}},"
+  end
+  f.puts "};"
+  f.puts
+
+  f.puts "static const ParseTimeagoTest PARSE_TIMEAGO_TESTS[] = {"
+  data.fetch('parse_timeago', []).each do |t|
+    name = c_escape(t['name'])
+    input = t['input'] || {}
+    text = input['text']
+    ref = input['reference']
+    output = t['output'] || {}
+    error = t['error'] ? 1 : 0
+    text_str = text ? "\"#{c_escape(text)}\"" : 'NULL'
+    render_str = t['render'] ? "\"#{c_escape(t['render'])}\"" : 'NULL'
+    human = t['formatter'] == 'human_date' ? 1 : 0
+    f.puts "    {\"#{name}\", #{text_str}, #{ref}, #{output['lo'] || 0}, #{output['hi'] || 0}, #{error}, #{render_str}, #{human}},"
+  end
+  f.puts "};"
+  f.puts
+
+  unit_flags = {
+    'year' => 'WW_UNIT_YEAR', 'month' => 'WW_UNIT_MONTH', 'day' => 'WW_UNIT_DAY',
+    'hour' => 'WW_UNIT_HOUR', 'minute' => 'WW_UNIT_MINUTE', 'second' => 'WW_UNIT_SECOND'
+  }
+  f.puts "static const DurationFormatTest DURATION_FORMAT_TESTS[] = {"
+  data.fetch('duration_format', []).each do |t|
+    name = c_escape(t['name'])
+    input = t['input'] || {}
+    units = input.key?('units') ? input['units'].map { |u| unit_flags.fetch(u) } : ['WW_UNIT_ALL']
+    units_str = units.empty? ? '0' : units.join(' | ')
+    compact = input['compact'] ? 1 : 0
+    max_units = input['max_units'] || 2
+    nearest = input['rounding'] == 'nearest' ? 1 : 0
+    separator = input['separator'] ? "\"#{c_escape(input['separator'])}\"" : 'NULL'
+    output = t['output']
+    error = t['error'] ? 1 : 0
+    output_str = output ? "\"#{c_escape(output)}\"" : 'NULL'
+    f.puts "    {\"#{name}\", #{input['seconds']}, #{units_str}, #{compact}, #{max_units}, #{nearest}, #{separator}, #{output_str}, #{error}},"
+  end
+  f.puts "};"
+  f.puts
+
+  clock_functions = { 'timeago' => 0, 'human_date' => 1, 'parse_timeago' => 2 }
+  f.puts "static const ClockTest CLOCK_TESTS[] = {"
+  data.fetch('clock', []).each do |t|
+    name = c_escape(t['name'])
+    input = t['input'] || {}
+    function = clock_functions.fetch(input['function'])
+    cached = input['mode'] == 'cached' ? 1 : 0
+    text_str = input['text'] ? "\"#{c_escape(input['text'])}\"" : 'NULL'
+    output = t['output']
+    output_str = output.is_a?(String) ? "\"#{c_escape(output)}\"" : 'NULL'
+    range = output.is_a?(Hash) ? output : {}
+    error = t['error'] ? 1 : 0
+    f.puts "    {\"#{name}\", #{function}, #{cached}, #{input['now']}, #{input['timestamp'] || 0}, #{text_str}, " \
+           "#{output_str}, #{range['lo'] || 0}, #{range['hi'] || 0}, #{error}},"
+  end
+  f.puts "};"
+  f.puts
+
+  append_functions = { 'timeago' => 0, 'duration' => 1, 'human_date' => 2, 'date_range' => 3 }
+  escape_modes = { 'none' => 'WW_ESCAPE_NONE', 'json' => 'WW_ESCAPE_JSON', 'html' => 'WW_ESCAPE_HTML' }
+  f.puts "static const AppendTest APPEND_TESTS[] = {"
+  data.fetch('append', []).each do |t|
+    name = c_escape(t['name'])
+    input = t['input'] || {}
+    first = input['timestamp'] || input['seconds'] || input['start']
+    second = input['reference'] || input['end'] || 0
+    output = t['output']
+    error = t['error'] ? 1 : 0
+    output_str = output ? "\"#{c_escape(output)}\"" : 'NULL'
+    f.puts "    {\"#{name}\", #{append_functions.fetch(input['function'])}, #{escape_modes.fetch(input['escape'])}, " \
+           "\"#{c_escape(input['prefix'])}\", #{input['capacity'] || 0}, #{first}, #{second}, #{output_str}, #{error}},"
+  end
+  f.puts "};"
+  f.puts
+
+  batch_functions = { 'timeago' => 0, 'human_date' => 1 }
+  batch_tests = data.fetch('batch', [])
+  batch_tests.each_with_index do |t, i|
+    rows = t['input']['rows']
+    next if rows.empty?
+
+    raise "#{t['name']}: more than 16 rows" if rows.size > 16
+
+    f.puts "static const BatchRow BATCH_ROWS_#{i}[] = {"
+    rows.zip(t['output']['rows']).each do |row, output|
+      f.puts "    {#{timestamp_input(row)}, \"#{c_escape(output)}\"},"
+    end
+    f.puts "};"
+    f.puts
+  end
+  f.puts "static const BatchTest BATCH_TESTS[] = {"
+  batch_tests.each_with_index do |t, i|
+    input = t['input']
+    ref = input['reference']
+    rows = input['rows'].empty? ? 'NULL' : "BATCH_ROWS_#{i}"
+    f.puts "    {\"#{c_escape(t['name'])}\", #{batch_functions.fetch(input['function'])}, #{ref ? 1 : 0}, #{ref || 0}, " \
+           "#{rows}, #{input['rows'].size}, #{t['output']['valid']}},"
+  end
+  f.puts "};"
+  f.puts
+
+  column_functions = { 'timeago' => 0, 'human_date' => 1, 'duration' => 2 }
+  column_tests = data.fetch('column', [])
+  column_tests.each_with_index do |t, i|
+    input = t['input']
+    values = input['values']
+    next if values.empty?
+
+    raise "#{t['name']}: more than 16 rows" if values.size > 16
+
+    type = input.key?('ticks_per_second') ? 'int64_t' : 'double'
+    f.puts "static const #{type} COLUMN_VALUES_#{i}[] = {#{values.join(', ')}};"
+    if input['validity']
+      bytes = input['validity'].each_slice(8).map do |bits|
+        bits.each_with_index.sum { |bit, b| bit << b }
+      end
+      f.puts "static const uint8_t COLUMN_VALIDITY_#{i}[] = {#{bytes.map { |b| format('0x%02x', b) }.join(', ')}};"
+    end
+    if t['output'] && !t['output'].empty?
+      rows = t['output'].map { |row| row.nil? ? 'NULL' : "\"#{c_escape(row)}\"" }
+      f.puts "static const char *const COLUMN_ROWS_#{i}[] = {#{rows.join(', ')}};"
+    end
+    f.puts
+  end
+  f.puts "static const ColumnTest COLUMN_TESTS[] = {"
+  column_tests.each_with_index do |t, i|
+    input = t['input']
+    values = input['values']
+    int64 = input.key?('ticks_per_second')
+    values_name = values.empty? ? 'NULL' : "COLUMN_VALUES_#{i}"
+    i64 = int64 ? values_name : 'NULL'
+    f64 = int64 ? 'NULL' : values_name
+    validity = input['validity'] ? "COLUMN_VALIDITY_#{i}" : 'NULL'
+    offset = input['offset'] || 0
+    length = input['length'] || (values.size - offset)
+    rows = t['output'] && !t['output'].empty? ? "COLUMN_ROWS_#{i}" : 'NULL'
+    error = t['error'] ? 1 : 0
+    f.puts "    {\"#{c_escape(t['name'])}\", #{column_functions.fetch(input['function'])}, #{i64}, #{f64}, #{validity}, " \
+           "#{offset}, #{length}, #{input['ticks_per_second'] || 1}, #{input['reference'] || 0}, #{rows}, #{error}},"
+  end
+  f.puts "};"
+  f.puts
+
+  calendar_steps = { 'day' => 'WW_STEP_DAY', 'week' => 'WW_STEP_WEEK', 'month' => 'WW_STEP_MONTH' }
+  calendar_tests = data.fetch('calendar', [])
+  calendar_tests.each_with_index do |t, i|
+    next unless t['output']
+
+    f.puts "static const CalendarSpan CALENDAR_SPANS_#{i}[] = {"
+    t['output'].each do |span|
+      f.puts "    {#{c_date(span['first'])}, #{c_date(span['last'])}, \"#{c_escape(span['label'])}\"},"
+    end
+    f.puts "};"
+    f.puts
+  end
+  f.puts "static const CalendarTest CALENDAR_TESTS[] = {"
+  calendar_tests.each_with_index do |t, i|
+    input = t['input']
+    spans = t['output'] ? "CALENDAR_SPANS_#{i}" : 'NULL'
+    count = t['output'] ? t['output'].size : 0
+    error = t['error'] ? 1 : 0
+    f.puts "    {\"#{c_escape(t['name'])}\", #{timestamp_input(input['start'])}, #{timestamp_input(input['end'])}, " \
+           "#{calendar_steps.fetch(input['step'])}, #{input['label_size'] || 64}, #{spans}, #{count}, #{error}},"
+  end
+  f.puts "};"
+  f.puts
+
+  describe_views = [%w[timeago WW_DESCRIBE_TIMEAGO], %w[human_date WW_DESCRIBE_HUMAN_DATE],
+                    %w[date_range WW_DESCRIBE_DATE_RANGE]]
+  f.puts "static const DescribeTest DESCRIBE_TESTS[] = {"
+  data.fetch('describe', []).each do |t|
+    input = t['input']
+    prefix = input['prefix'] || ''
+    flags = input['flags'].map { |flag| describe_views.assoc(flag).fetch(1) }
+    output = t['output'] || {}
+    position = prefix.bytesize
+    views = []
+    spans = []
+    describe_views.each do |view, _|
+      text = output[view]
+      views << (text ? "\"#{c_escape(text)}\"" : 'NULL')
+      spans << (text ? "{#{position}, #{text.bytesize}}" : '{0, 0}')
+      position += text.bytesize if text
+    end
+    error = t['error'] ? 1 : 0
+    f.puts "    {\"#{c_escape(t['name'])}\", \"#{c_escape(prefix)}\", #{input['capacity'] || 0}, #{input['timestamp']}, " \
+           "#{input['reference']}, #{timestamp_input(input['end'])}, #{flags.empty? ? '0' : flags.join(' | ')}, " \
+           "{#{views.join(', ')}}, {#{spans.join(', ')}}, #{error}},"
+  end
+  f.puts "};"
+  f.puts
+
   f.puts "static int expect_string(const char *name, const char *got, const char *expected, int expect_error) {"
   f.puts "    if (expect_error) {"
   f.puts "        if (got != NULL) {"
@@ -173,6 +530,333 @@ File.open('tests.c', 'w') do |f|
   f.puts "}"
   f.puts
 
+  f.puts "static int expect_render(const char *name, const ParseTimeagoTest *t, double ts, int match) {"
+  f.puts "    ww_timestamp stamp = ww_timestamp_from_unix(ts);"
+  f.puts "    ww_timestamp ref = ww_timestamp_from_unix(t->reference);"
+  f.puts "    char *got = t->human_date ? human_date(stamp, ref) : timeago(stamp, ref);"
+  f.puts "    int failed = got == NULL || (strcmp(got, t->render) == 0) != match;"
+  f.puts "    if (failed) {"
+  f.puts "        fprintf(stderr, \"FAIL: %s (%.9f renders '%s', expected %s'%s')\\n\", name, ts, got ? got : \"(error)\","
+  f.puts "                match ? \"\" : \"not \", t->render);"
+  f.puts "    }"
+  f.puts "    free(got);"
+  f.puts "    return failed;"
+  f.puts "}"
+  f.puts
+
+  f.puts "/* Returns a buffer already holding `prefix`: fixed over `storage` when"
+  f.puts " * `capacity` is non-zero, otherwise growable and heap-allocated. */"
+  f.puts "static ww_buf test_buffer(const char *prefix, char *storage, size_t capacity) {"
+  f.puts "    size_t len = strlen(prefix);"
+  f.puts "    ww_buf buf = capacity > 0 ? ww_buf_init(storage, capacity, NULL)"
+  f.puts "                              : ww_buf_init((char *)malloc(len + 1), len + 1, realloc);"
+  f.puts "    memcpy(buf.ptr, prefix, len + 1);"
+  f.puts "    buf.len = len;"
+  f.puts "    return buf;"
+  f.puts "}"
+  f.puts
+
+  f.puts "static int run_append(const AppendTest *t) {"
+  f.puts "    char storage[256];"
+  f.puts "    ww_buf buf = test_buffer(t->prefix, storage, t->capacity);"
+  f.puts "    ww_timestamp first = ww_timestamp_from_unix(t->first);"
+  f.puts "    ww_timestamp second = ww_timestamp_from_unix(t->second);"
+  f.puts "    bool ok = false;"
+  f.puts "    if (t->function == 0) {"
+  f.puts "        ok = timeago_append(&buf, t->mode, first, second);"
+  f.puts "    } else if (t->function == 1) {"
+  f.puts "        ok = duration_append(&buf, t->mode, t->first, NULL);"
+  f.puts "    } else if (t->function == 2) {"
+  f.puts "        ok = human_date_append(&buf, t->mode, first, second);"
+  f.puts "    } else {"
+  f.puts "        ok = date_range_append(&buf, t->mode, first, second);"
+  f.puts "    }"
+  f.puts "    const char *expected = t->error ? t->prefix : t->output;"
+  f.puts "    int failed = ok == (bool)t->error || buf.len != strlen(expected) || strcmp(buf.ptr, expected) != 0;"
+  f.puts "    if (failed) {"
+  f.puts "        fprintf(stderr, \"FAIL: %s (returned %d with '%s', expected %d with '%s')\\n\", t->name, ok, buf.ptr,"
+  f.puts "                !t->error, expected);"
+  f.puts "    }"
+  f.puts "    if (t->capacity == 0) {"
+  f.puts "        free(buf.ptr);"
+  f.puts "    }"
+  f.puts "    return failed;"
+  f.puts "}"
+  f.puts
+
+  f.puts "static ww_timestamp timestamp_from_input(const TimestampInput *input) {"
+  f.puts "    if (input->kind == WW_TS_ISO) {"
+  f.puts "        return ww_timestamp_from_iso(input->iso);"
+  f.puts "    }"
+  f.puts "    return input->kind == WW_TS_UNIX ? ww_timestamp_from_unix(input->unix_seconds) : ww_timestamp_unset();"
+  f.puts "}"
+  f.puts
+
+  f.puts "/* Checks n + 1 offsets into `buf` that start after `mark`, and each row's text. */"
+  f.puts "static int expect_rows(const char *name, const ww_buf *buf, size_t mark, const size_t *offsets,"
+  f.puts "                       const BatchRow *rows, size_t n) {"
+  f.puts "    if (offsets[0] != mark || offsets[n] != buf->len) {"
+  f.puts "        fprintf(stderr, \"FAIL: %s (offsets span %zu..%zu, buffer spans %zu..%zu)\\n\", name, offsets[0], offsets[n],"
+  f.puts "                mark, buf->len);"
+  f.puts "        return 1;"
+  f.puts "    }"
+  f.puts "    int failures = 0;"
+  f.puts "    for (size_t i = 0; i < n; i++) {"
+  f.puts "        size_t len = offsets[i + 1] - offsets[i];"
+  f.puts "        if (offsets[i + 1] < offsets[i] || len != strlen(rows[i].output) ||"
+  f.puts "            memcmp(buf->ptr + offsets[i], rows[i].output, len) != 0) {"
+  f.puts "            fprintf(stderr, \"FAIL: %s row %zu (expected '%s')\\n\", name, i, rows[i].output);"
+  f.puts "            failures++;"
+  f.puts "        }"
+  f.puts "    }"
+  f.puts "    return failures;"
+  f.puts "}"
+  f.puts
+
+  f.puts "static int run_batch(const BatchTest *t) {"
+  f.puts "    ww_timestamp inputs[BATCH_MAX_ROWS];"
+  f.puts "    ww_packed_ts packed[BATCH_MAX_ROWS];"
+  f.puts "    size_t offsets[BATCH_MAX_ROWS + 1];"
+  f.puts "    for (size_t i = 0; i < t->count; i++) {"
+  f.puts "        inputs[i] = timestamp_from_input(&t->rows[i].first);"
+  f.puts "    }"
+  f.puts "    int failures = 0;"
+  f.puts "    size_t valid = ww_timestamp_pack_array(inputs, t->count, packed);"
+  f.puts "    if (valid != t->valid) {"
+  f.puts "        fprintf(stderr, \"FAIL: %s (packed %zu valid, expected %zu)\\n\", t->name, valid, t->valid);"
+  f.puts "        failures++;"
+  f.puts "    }"
+  f.puts "    for (size_t i = 0; i < t->count; i++) {"
+  f.puts "        if (ww_packed_is_set(packed[i]) != (t->rows[i].output[0] != '\\0')) {"
+  f.puts "            fprintf(stderr, \"FAIL: %s row %zu (wrong NaN tag)\\n\", t->name, i);"
+  f.puts "            failures++;"
+  f.puts "        }"
+  f.puts "    }"
+  f.puts "    ww_buf buf = test_buffer(\"#\", NULL, 0);"
+  f.puts "    ww_packed_ts reference = t->has_reference ? t->reference : NAN;"
+  f.puts "    bool ok = t->function == 0 ? timeago_batch(&buf, WW_ESCAPE_NONE, packed, t->count, reference, offsets)"
+  f.puts "                               : human_date_batch(&buf, WW_ESCAPE_NONE, packed, t->count, reference, offsets);"
+  f.puts "    if (!ok) {"
+  f.puts "        fprintf(stderr, \"FAIL: %s (batch returned false)\\n\", t->name);"
+  f.puts "        failures++;"
+  f.puts "    } else {"
+  f.puts "        failures += expect_rows(t->name, &buf, 1, offsets, t->rows, t->count);"
+  f.puts "    }"
+  f.puts "    free(buf.ptr);"
+  f.puts "    return failures;"
+  f.puts "}"
+  f.puts
+
+  f.puts "static int run_column(const ColumnTest *t) {"
+  f.puts "    ww_column column = t->i64 ? ww_column_from_int64(t->i64, t->validity, t->length, t->ticks_per_second)"
+  f.puts "                              : ww_column_from_double(t->f64, t->validity, t->length);"
+  f.puts "    column.offset = t->offset;"
+  f.puts "    int32_t offsets[COLUMN_MAX_ROWS + 1];"
+  f.puts "    uint8_t validity[COLUMN_MAX_ROWS / 8] = {0xaa, 0xaa};"
+  f.puts "    ww_buf data = ww_buf_init(NULL, 0, realloc);"
+  f.puts "    bool ok = false;"
+  f.puts "    if (t->function == 0) {"
+  f.puts "        ok = timeago_column(&column, t->reference, &data, offsets, validity);"
+  f.puts "    } else if (t->function == 1) {"
+  f.puts "        ok = human_date_column(&column, t->reference, &data, offsets, validity);"
+  f.puts "    } else {"
+  f.puts "        ok = duration_column(&column, NULL, &data, offsets, validity);"
+  f.puts "    }"
+  f.puts "    int failures = 0;"
+  f.puts "    if (ok == (bool)t->error) {"
+  f.puts "        fprintf(stderr, \"FAIL: %s (returned %d)\\n\", t->name, ok);"
+  f.puts "        failures++;"
+  f.puts "    } else if (ok && (offsets[0] != 0 || offsets[t->length] != (int32_t)data.len)) {"
+  f.puts "        fprintf(stderr, \"FAIL: %s (offsets span %d..%d for %zu bytes)\\n\", t->name, offsets[0],"
+  f.puts "                offsets[t->length], data.len);"
+  f.puts "        failures++;"
+  f.puts "    } else if (ok) {"
+  f.puts "        for (size_t i = 0; i < t->length; i++) {"
+  f.puts "            const char *expected = t->rows[i] ? t->rows[i] : \"\";"
+  f.puts "            size_t len = (size_t)(offsets[i + 1] - offsets[i]);"
+  f.puts "            bool bit = (validity[i / 8] >> (i % 8)) & 1u;"
+  f.puts "            if (offsets[i + 1] < offsets[i] || bit != (t->rows[i] != NULL) || len != strlen(expected) ||"
+  f.puts "                memcmp(data.ptr + offsets[i], expected, len) != 0) {"
+  f.puts "                fprintf(stderr, \"FAIL: %s row %zu (expected %s'%s')\\n\", t->name, i, t->rows[i] ? \"\" : \"null \","
+  f.puts "                        expected);"
+  f.puts "                failures++;"
+  f.puts "            }"
+  f.puts "        }"
+  f.puts "    }"
+  f.puts "    free(data.ptr);"
+  f.puts "    return failures;"
+  f.puts "}"
+  f.puts
+
+  f.puts "static int same_date(const ww_date *a, const ww_date *b) {"
+  f.puts "    return a->days == b->days && a->year == b->year && a->month == b->month && a->day == b->day &&"
+  f.puts "           a->weekday == b->weekday;"
+  f.puts "}"
+  f.puts
+
+  f.puts "static int run_calendar(const CalendarTest *t) {"
+  f.puts "    ww_calendar_iter it;"
+  f.puts "    bool ok = ww_calendar_iter_init(&it, timestamp_from_input(&t->start), timestamp_from_input(&t->end), t->step);"
+  f.puts "    if (ok == (bool)t->error) {"
+  f.puts "        fprintf(stderr, \"FAIL: %s (init returned %d)\\n\", t->name, ok);"
+  f.puts "        return 1;"
+  f.puts "    }"
+  f.puts "    int failures = 0;"
+  f.puts "    for (size_t i = 0; ok && i <= t->count; i++) {"
+  f.puts "        ww_date first;"
+  f.puts "        ww_date last;"
+  f.puts "        char label[64];"
+  f.puts "        memset(label, 'x', sizeof(label));"
+  f.puts "        bool more = ww_calendar_iter_next(&it, &first, &last, label, t->label_size);"
+  f.puts "        if (i == t->count) {"
+  f.puts "            if (more) {"
+  f.puts "                fprintf(stderr, \"FAIL: %s (extra span '%s')\\n\", t->name, label);"
+  f.puts "                failures++;"
+  f.puts "            }"
+  f.puts "        } else if (!more || !same_date(&first, &t->spans[i].first) || !same_date(&last, &t->spans[i].last) ||"
+  f.puts "                   strcmp(label, t->spans[i].label) != 0) {"
+  f.puts "            fprintf(stderr, \"FAIL: %s span %zu (expected '%s')\\n\", t->name, i, t->spans[i].label);"
+  f.puts "            failures++;"
+  f.puts "            break;"
+  f.puts "        }"
+  f.puts "    }"
+  f.puts "    return failures;"
+  f.puts "}"
+  f.puts
+
+  f.puts "static int same_span(const ww_span *a, const ww_span *b) {"
+  f.puts "    return a->offset == b->offset && a->length == b->length;"
+  f.puts "}"
+  f.puts
+
+  f.puts "static int run_describe(const DescribeTest *t) {"
+  f.puts "    char storage[256];"
+  f.puts "    ww_buf buf = test_buffer(t->prefix, storage, t->capacity);"
+  f.puts "    ww_description got;"
+  f.puts "    memset(&got, 0xff, sizeof(got));"
+  f.puts "    bool ok = ww_describe(&buf, WW_ESCAPE_NONE, ww_timestamp_from_unix(t->timestamp),"
+  f.puts "                          ww_timestamp_from_unix(t->reference), timestamp_from_input(&t->end), t->flags, &got);"
+  f.puts "    int failed = ok == (bool)t->error || !same_span(&got.timeago, &t->expected.timeago) ||"
+  f.puts "                 !same_span(&got.human_date, &t->expected.human_date) ||"
+  f.puts "                 !same_span(&got.date_range, &t->expected.date_range);"
+  f.puts "    const ww_span *spans[3] = {&got.timeago, &got.human_date, &got.date_range};"
+  f.puts "    size_t end = strlen(t->prefix);"
+  f.puts "    for (size_t i = 0; i < 3 && !failed; i++) {"
+  f.puts "        if (t->views[i]) {"
+  f.puts "            failed = memcmp(buf.ptr + spans[i]->offset, t->views[i], spans[i]->length) != 0;"
+  f.puts "            end = spans[i]->offset + spans[i]->length;"
+  f.puts "        }"
+  f.puts "    }"
+  f.puts "    if (!failed && (buf.len != end || strncmp(buf.ptr, t->prefix, strlen(t->prefix)) != 0)) {"
+  f.puts "        failed = 1;"
+  f.puts "    }"
+  f.puts "    if (failed) {"
+  f.puts "        fprintf(stderr, \"FAIL: %s (returned %d with '%s')\\n\", t->name, ok, buf.ptr);"
+  f.puts "    }"
+  f.puts "    if (t->capacity == 0) {"
+  f.puts "        free(buf.ptr);"
+  f.puts "    }"
+  f.puts "    return failed;"
+  f.puts "}"
+  f.puts
+
+  f.puts "#define DATE_RANGE_COUNT (sizeof(DATE_RANGE_TESTS) / sizeof(DATE_RANGE_TESTS[0]))"
+  f.puts "#define DATE_RANGE_BATCH_ROUNDS 8"
+  f.puts "#define DATE_RANGE_BATCH_ROWS (DATE_RANGE_BATCH_ROUNDS * (DATE_RANGE_COUNT + 2))"
+  f.puts
+
+  f.puts "/* Runs every date_range case through date_range_batch, repeated so the"
+  f.puts " * batch spans more than one internal block, with a NaN end and a NaN start"
+  f.puts " * after each round. */"
+  f.puts "static int run_date_range_batch(void) {"
+  f.puts "    static ww_packed_ts starts[DATE_RANGE_BATCH_ROWS];"
+  f.puts "    static ww_packed_ts ends[DATE_RANGE_BATCH_ROWS];"
+  f.puts "    static BatchRow rows[DATE_RANGE_BATCH_ROWS];"
+  f.puts "    static size_t offsets[DATE_RANGE_BATCH_ROWS + 1];"
+  f.puts "    size_t n = 0;"
+  f.puts "    for (size_t round = 0; round < DATE_RANGE_BATCH_ROUNDS; round++) {"
+  f.puts "        for (size_t i = 0; i < DATE_RANGE_COUNT; i++) {"
+  f.puts "            const DateRangeTest *t = &DATE_RANGE_TESTS[i];"
+  f.puts "            starts[n] = t->start;"
+  f.puts "            ends[n] = t->end;"
+  f.puts "            rows[n++].output = t->error ? \"\" : t->output;"
+  f.puts "        }"
+  f.puts "        starts[n] = DATE_RANGE_TESTS[0].start;"
+  f.puts "        ends[n] = NAN;"
+  f.puts "        rows[n++].output = \"\";"
+  f.puts "        starts[n] = NAN;"
+  f.puts "        ends[n] = DATE_RANGE_TESTS[0].end;"
+  f.puts "        rows[n++].output = \"\";"
+  f.puts "    }"
+  f.puts "    ww_buf buf = test_buffer(\"#\", NULL, 0);"
+  f.puts "    int failures = 0;"
+  f.puts "    if (!date_range_batch(&buf, WW_ESCAPE_NONE, starts, ends, n, offsets)) {"
+  f.puts "        fprintf(stderr, \"FAIL: date_range_batch (returned false)\\n\");"
+  f.puts "        failures++;"
+  f.puts "    } else {"
+  f.puts "        failures += expect_rows(\"date_range_batch\", &buf, 1, offsets, rows, n);"
+  f.puts "    }"
+  f.puts "    free(buf.ptr);"
+  f.puts "    buf = test_buffer(\"#\", NULL, 0);"
+  f.puts "    offsets[0] = 99;"
+  f.puts "    if (!date_range_batch(&buf, WW_ESCAPE_NONE, NULL, NULL, 0, offsets) || offsets[0] != 1 || buf.len != 1) {"
+  f.puts "        fprintf(stderr, \"FAIL: date_range_batch (empty batch)\\n\");"
+  f.puts "        failures++;"
+  f.puts "    }"
+  f.puts "    free(buf.ptr);"
+  f.puts "    return failures;"
+  f.puts "}"
+  f.puts
+
+  f.puts "static int run_parse_duration_tests(void) {"
+  f.puts "    int failures = 0;"
+  f.puts "    for (size_t i = 0; i < sizeof(PARSE_DURATION_TESTS) / sizeof(PARSE_DURATION_TESTS[0]); i++) {"
+  f.puts "        const ParseDurationTest *t = &PARSE_DURATION_TESTS[i];"
+  f.puts "        double value = 0.0;"
+  f.puts "        int ok = parse_duration(t->input, &value);"
+  f.puts "        failures += expect_number(t->name, ok, value, t->output, t->error);"
+  f.puts "    }"
+  f.puts "    for (size_t i = 0; i < sizeof(PARSE_DURATION_GRAMMAR_TESTS) / sizeof(PARSE_DURATION_GRAMMAR_TESTS[0]); i++) {"
+  f.puts "        const ParseDurationTest *t = &PARSE_DURATION_GRAMMAR_TESTS[i];"
+  f.puts "        double value = 0.0;"
+  f.puts "        int ok = parse_duration(t->input, &value);"
+  f.puts "        failures += expect_number(t->name, ok, value, t->output, t->error);"
+  f.puts "    }"
+  f.puts "    for (size_t i = 0; i < sizeof(PARSE_DURATION_NS_TESTS) / sizeof(PARSE_DURATION_NS_TESTS[0]); i++) {"
+  f.puts "        const ParseDurationTest *t = &PARSE_DURATION_NS_TESTS[i];"
+  f.puts "        int64_t value = 0;"
+  f.puts "        int ok = parse_duration_ns(t->input, &value);"
+  f.puts "        failures += expect_number(t->name, ok, (double)value, t->output, t->error);"
+  f.puts "    }"
+  f.puts "    return failures;"
+  f.puts "}"
+  f.puts
+
+  f.puts "/* Re-runs the duration parser cases under the first installed LC_NUMERIC"
+  f.puts " * locale whose decimal point is not '.', trying $WW_TEST_LOCALE first. */"
+  f.puts "static int run_locale_tests(void) {"
+  f.puts "    const char *candidates[] = {getenv(\"WW_TEST_LOCALE\"), \"de_DE.UTF-8\", \"de_DE.utf8\", \"fr_FR.UTF-8\","
+  f.puts "                                \"fr_FR.utf8\", \"de_DE\", \"fr_FR\"};"
+  f.puts "    const char *name = NULL;"
+  f.puts "    for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]) && !name; i++) {"
+  f.puts "        if (candidates[i] && setlocale(LC_NUMERIC, candidates[i]) && strcmp(localeconv()->decimal_point, \".\") != 0) {"
+  f.puts "            name = candidates[i];"
+  f.puts "        }"
+  f.puts "    }"
+  f.puts "    if (!name) {"
+  f.puts "        setlocale(LC_NUMERIC, \"C\");"
+  f.puts "        printf(\"Skipped locale tests: no comma-decimal locale installed (set WW_TEST_LOCALE).\\n\");"
+  f.puts "        return 0;"
+  f.puts "    }"
+  f.puts "    int failures = run_parse_duration_tests();"
+  f.puts "    setlocale(LC_NUMERIC, \"C\");"
+  f.puts "    if (failures > 0) {"
+  f.puts "        fprintf(stderr, \"FAIL: %d duration parser cases under LC_NUMERIC=%s\\n\", failures, name);"
+  f.puts "    }"
+  f.puts "    return failures;"
+  f.puts "}"
+  f.puts
+
   f.puts "int main(void) {"
   f.puts "    int failures = 0;"
   f.puts
@@ -200,12 +884,7 @@ File.open('tests.c', 'w') do |f|
   f.puts "        failures += expect_string(t->name, result, t->output, t->error);"
   f.puts "    }"
   f.puts
-  f.puts "    for (size_t i = 0; i < sizeof(PARSE_DURATION_TESTS) / sizeof(PARSE_DURATION_TESTS[0]); i++) {"
-  f.puts "        const ParseDurationTest *t = &PARSE_DURATION_TESTS[i];"
-  f.puts "        double value = 0.0;"
-  f.puts "        int ok = parse_duration(t->input, &value);"
-  f.puts "        failures += expect_number(t->name, ok, value, t->output, t->error);"
-  f.puts "    }"
+  f.puts "    failures += run_parse_duration_tests();"
   f.puts
   f.puts "    for (size_t i = 0; i < sizeof(HUMAN_DATE_TESTS) / sizeof(HUMAN_DATE_TESTS[0]); i++) {"
   f.puts "        const HumanDateTest *t = &HUMAN_DATE_TESTS[i];"
@@ -219,6 +898,94 @@ File.open('tests.c', 'w') do |f|
   f.puts "        failures += expect_string(t->name, result, t->output, t->error);"
   f.puts "    }"
   f.puts
+  f.puts "    failures += run_locale_tests();"
+  f.puts
+  f.puts "    for (size_t i = 0; i < sizeof(PARSE_TIMEAGO_TESTS) / sizeof(PARSE_TIMEAGO_TESTS[0]); i++) {"
+  f.puts "        const ParseTimeagoTest *t = &PARSE_TIMEAGO_TESTS[i];"
+  f.puts "        double lo = 0.0;"
+  f.puts "        double hi = 0.0;"
+  f.puts "        int ok = parse_timeago(t->input, ww_timestamp_from_unix(t->reference), &lo, &hi);"
+  f.puts "        failures += expect_number(t->name, ok, lo, t->lo, t->error);"
+  f.puts "        if (ok && !t->error) {"
+  f.puts "            failures += expect_number(t->name, ok, hi, t->hi, t->error);"
+  f.puts "        }"
+  f.puts "        if (ok && t->render) {"
+  f.puts "            failures += expect_render(t->name, t, lo, 1);"
+  f.puts "            failures += expect_render(t->name, t, nextafter(hi, -HUGE_VAL), 1);"
+  f.puts "            failures += expect_render(t->name, t, hi, 0);"
+  f.puts "            failures += expect_render(t->name, t, nextafter(lo, -HUGE_VAL), 0);"
+  f.puts "        }"
+  f.puts "    }"
+  f.puts
+  f.puts "    for (size_t i = 0; i < sizeof(DURATION_FORMAT_TESTS) / sizeof(DURATION_FORMAT_TESTS[0]); i++) {"
+  f.puts "        const DurationFormatTest *t = &DURATION_FORMAT_TESTS[i];"
+  f.puts "        ww_duration_spec spec = ww_duration_spec_default();"
+  f.puts "        spec.units = t->units;"
+  f.puts "        spec.compact = t->compact;"
+  f.puts "        spec.max_units = t->max_units;"
+  f.puts "        spec.rounding = t->nearest ? WW_DURATION_ROUND_NEAREST : WW_DURATION_ROUND_FLOOR;"
+  f.puts "        spec.separator = t->separator;"
+  f.puts "        ww_duration_plan plan;"
+  f.puts "        ww_buf buf = ww_buf_init(NULL, 0, realloc);"
+  f.puts "        char *result = NULL;"
+  f.puts "        if (ww_duration_format_compile(&spec, &plan) && ww_duration_format_exec(&plan, t->seconds, &buf)) {"
+  f.puts "            result = buf.ptr;"
+  f.puts "        } else {"
+  f.puts "            free(buf.ptr);"
+  f.puts "        }"
+  f.puts "        failures += expect_string(t->name, result, t->output, t->error);"
+  f.puts "    }"
+  f.puts
+  f.puts "    for (size_t i = 0; i < sizeof(CLOCK_TESTS) / sizeof(CLOCK_TESTS[0]); i++) {"
+  f.puts "        const ClockTest *t = &CLOCK_TESTS[i];"
+  f.puts "        ww_clock_set_mode(t->cached ? WW_CLOCK_CACHED : WW_CLOCK_OFF);"
+  f.puts "        ww_clock_set(t->now);"
+  f.puts "        ww_timestamp stamp = ww_timestamp_from_unix(t->timestamp);"
+  f.puts "        if (t->function == 0) {"
+  f.puts "            failures += expect_string(t->name, timeago(stamp, ww_timestamp_unset()), t->output, t->error);"
+  f.puts "        } else if (t->function == 1) {"
+  f.puts "            failures += expect_string(t->name, human_date(stamp, ww_timestamp_unset()), t->output, t->error);"
+  f.puts "        } else {"
+  f.puts "            double lo = 0.0;"
+  f.puts "            double hi = 0.0;"
+  f.puts "            int ok = parse_timeago(t->text, ww_timestamp_unset(), &lo, &hi);"
+  f.puts "            failures += expect_number(t->name, ok, lo, t->lo, t->error);"
+  f.puts "            if (ok && !t->error) {"
+  f.puts "                failures += expect_number(t->name, ok, hi, t->hi, t->error);"
+  f.puts "            }"
+  f.puts "        }"
+  f.puts "    }"
+  f.puts "    ww_clock_set_mode(WW_CLOCK_OFF);"
+  f.puts
+
+  f.puts "    for (size_t i = 0; i < sizeof(APPEND_TESTS) / sizeof(APPEND_TESTS[0]); i++) {"
+  f.puts "        failures += run_append(&APPEND_TESTS[i]);"
+  f.puts "    }"
+  f.puts
+
+  f.puts "    for (size_t i = 0; i < sizeof(BATCH_TESTS) / sizeof(BATCH_TESTS[0]); i++) {"
+  f.puts "        failures += run_batch(&BATCH_TESTS[i]);"
+  f.puts "    }"
+  f.puts
+
+  f.puts "    for (size_t i = 0; i < sizeof(COLUMN_TESTS) / sizeof(COLUMN_TESTS[0]); i++) {"
+  f.puts "        failures += run_column(&COLUMN_TESTS[i]);"
+  f.puts "    }"
+  f.puts
+
+  f.puts "    for (size_t i = 0; i < sizeof(CALENDAR_TESTS) / sizeof(CALENDAR_TESTS[0]); i++) {"
+  f.puts "        failures += run_calendar(&CALENDAR_TESTS[i]);"
+  f.puts "    }"
+  f.puts
+
+  f.puts "    for (size_t i = 0; i < sizeof(DESCRIBE_TESTS) / sizeof(DESCRIBE_TESTS[0]); i++) {"
+  f.puts "        failures += run_describe(&DESCRIBE_TESTS[i]);"
+  f.puts "    }"
+  f.puts
+
+  f.puts "    failures += run_date_range_batch();"
+  f.puts
+
   f.puts "    if (failures == 0) {"
   f.puts "        printf(\"All tests passed.\\n\");"
   f.puts "        return 0;"
@@ -1,3 +1,4 @@
+#include <locale.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -45,6 +46,123 @@ typedef struct {
     int error;
 } DateRangeTest;
 
+typedef struct {
+    const char *name;
+    const char *input;
+    double reference;
+    double lo;
+    double hi;
+    int error;
+    const char *render;
+    int human_date;
+} ParseTimeagoTest;
+
+typedef struct {
+    const char *name;
+    double seconds;
+    unsigned units;
+    int compact;
+    int max_units;
+    int nearest;
+    const char *separator;
+    const char *output;
+    int error;
+} DurationFormatTest;
+
+typedef struct {
+    const char *name;
+    int function;
+    int cached;
+    double now;
+    double timestamp;
+    const char *text;
+    const char *output;
+    double lo;
+    double hi;
+    int error;
+} ClockTest;
+
+typedef struct {
+    const char *name;
+    int function;
+    ww_escape_mode mode;
+    const char *prefix;
+    size_t capacity;
+    double first;
+    double second;
+    const char *output;
+    int error;
+} AppendTest;
+
+typedef struct {
+    ww_timestamp_kind kind;
+    double unix_seconds;
+    const char *iso;
+} TimestampInput;
+
+typedef struct {
+    TimestampInput first;
+    const char *output;
+} BatchRow;
+
+typedef struct {
+    const char *name;
+    int function;
+    int has_reference;
+    double reference;
+    const BatchRow *rows;
+    size_t count;
+    size_t valid;
+} BatchTest;
+
+#define BATCH_MAX_ROWS 16
+
+typedef struct {
+    const char *name;
+    int function;
+    const int64_t *i64;
+    const double *f64;
+    const uint8_t *validity;
+    size_t offset;
+    size_t length;
+    int64_t ticks_per_second;
+    double reference;
+    const char *const *rows;
+    int error;
+} ColumnTest;
+
+#define COLUMN_MAX_ROWS 16
+
+typedef struct {
+    ww_date first;
+    ww_date last;
+    const char *label;
+} CalendarSpan;
+
+typedef struct {
+    const char *name;
+    TimestampInput start;
+    TimestampInput end;
+    ww_calendar_step step;
+    size_t label_size;
+    const CalendarSpan *spans;
+    size_t count;
+    int error;
+} CalendarTest;
+
+typedef struct {
+    const char *name;
+    const char *prefix;
+    size_t capacity;
+    double timestamp;
+    double reference;
+    TimestampInput end;
+    unsigned flags;
+    const char *views[3];
+    ww_description expected;
+    int error;
+} DescribeTest;
+
 static const TimeagoTest TIMEAGO_TESTS[] = {
     {"just now - identical timestamps", 1704067200, 1704067200, "just now", 0},
     {"just now - 30 seconds ago", 1704067170, 1704067200, "just now", 0},
@@ -183,6 +301,261 @@ static const DateRangeTest DATE_RANGE_TESTS[] = {
     {"multi-year span", 1672531200, 1735689600, "January 1, 2023 – January 1, 2025", 0},
 };
 
+static const ParseDurationTest PARSE_DURATION_GRAMMAR_TESTS[] = {
+    {"colon notation with a space after the colon", "1: 30", 5400, 0},
+    {"colon notation with spaces around the colons", " 1 : 30 : 15 ", 5415, 0},
+    {"colon notation with a fractional last field", "1:30:00.5", 5400.5, 0},
+    {"error - colon notation with a fraction before the last field", "1.5:30", 0, 1},
+    {"long fraction rounds on the first dropped digit", "0.99999999999999999999999s", 1, 0},
+    {"error - exponent", "1e3s", 0, 1},
+    {"error - leading plus sign", "+5m", 0, 1},
+    {"error - hexadecimal count", "0x10s", 0, 1},
+    {"error - colon notation with a trailing colon", "1:30:", 0, 1},
+    {"error - count beyond int64", "99999999999999999999s", 0, 1},
+    {"error - decimal comma", "1,5h", 0, 1},
+    {"error - milliseconds are parse_duration_ns only", "5ms", 0, 1},
+    {"error - spaced nanoseconds are parse_duration_ns only", "5 ns", 0, 1},
+};
+
+static const ParseDurationTest PARSE_DURATION_NS_TESTS[] = {
+    {"compact hours minutes", "2h30m", 9000000000000.0, 0},
+    {"decimal hours are exact", "1.1h", 3960000000000.0, 0},
+    {"verbose with and", "2 hours, and 30 minutes", 9000000000000.0, 0},
+    {"go style", "1h30m15s", 5415000000000.0, 0},
+    {"go style sub-second units", "1m1.5s300ms20us7ns", 61800020007.0, 0},
+    {"go style micro sign", "15µs", 15000.0, 0},
+    {"spaced milliseconds", "5 ms", 5000000.0, 0},
+    {"iso 8601 time", "PT1H30M", 5400000000000.0, 0},
+    {"iso 8601 date and time", "P1DT2H", 93600000000000.0, 0},
+    {"iso 8601 weeks", "P2W", 1209600000000000.0, 0},
+    {"iso 8601 fractional seconds with comma", "PT0,25S", 250000000.0, 0},
+    {"colon notation", "1:30:00.5", 5400500000000.0, 0},
+    {"colon notation with spaces around the colons", " 1 : 30 : 15 ", 5415000000000.0, 0},
+    {"colon notation with a space after the colon", "1: 30", 5400000000000.0, 0},
+    {"error - colon notation with a fraction before the last field", "1.5:30", 0.0, 1},
+    {"error - colon notation with a trailing colon", "1:30:", 0.0, 1},
+    {"error - iso components out of order", "PT30M1H", 0.0, 1},
+    {"error - iso time marker without components", "P1DT", 0.0, 1},
+    {"error - just number", "42", 0.0, 1},
+    {"error - negative", "-5 hours", 0.0, 1},
+    {"error - overflow", "9999999999h", 0.0, 1},
+};
+
+static const ParseTimeagoTest PARSE_TIMEAGO_TESTS[] = {
+    {"just now", "just now", 1704067200, 1704067155, 1704067245, 0, NULL, 0},
+    {"1 minute ago", "1 minute ago", 1704067200, 1704067110, 1704067155, 0, NULL, 0},
+    {"3 hours ago", "3 hours ago", 1704067200, 1704054600, 1704058200, 0, NULL, 0},
+    {"45 minutes ago - clipped by bucket", "45 minutes ago", 1704067200, 1704064500, 1704064530, 0, NULL, 0},
+    {"in 2 days", "in 2 days", 1704067200, 1704196800, 1704283200, 0, NULL, 0},
+    {"case and whitespace insensitive", "  In 1 Hour ", 1704067200, 1704069900, 1704072600, 0, NULL, 0},
+    {"Yesterday", "Yesterday", 1704067200, 1703980800, 1704067200, 0, NULL, 0},
+    {"Last Tuesday", "Last Tuesday", 1704067200, 1703548800, 1703635200, 0, NULL, 0},
+    {"same year date", "March 1", 1704067200, 1709251200, 1709337600, 0, NULL, 0},
+    {"different year date", "March 1, 2023", 1704067200, 1677628800, 1677715200, 0, NULL, 0},
+    {"1 month ago", "1 month ago", 1704067200, 1700092800, 1701820800, 0, NULL, 0},
+    {"error - date inside relative window", "January 3", 1704067200, 0, 0, 1, NULL, 0},
+    {"error - Last on same weekday", "Last Monday", 1704067200, 0, 0, 1, NULL, 0},
+    {"error - invalid day", "February 30", 1704067200, 0, 0, 1, NULL, 0},
+    {"error - unknown unit", "5 fortnights ago", 1704067200, 0, 0, 1, NULL, 0},
+    {"error - empty string", "", 1704067200, 0, 0, 1, NULL, 0},
+    {"error - plural unit with a count of 1", "1 minutes ago", 1704067200, 0, 0, 1, NULL, 0},
+    {"error - singular unit with a count of 2", "2 minute ago", 1704067200, 0, 0, 1, NULL, 0},
+    {"error - plural unit in the future with a count of 1", "in 1 hours", 1704067200, 0, 0, 1, NULL, 0},
+    {"boundary - just now", "just now", 1704067200, 1704067155, 1704067245, 0, "just now", 0},
+    {"boundary - 3 hours ago", "3 hours ago", 1704067200, 1704054600, 1704058200, 0, "3 hours ago", 0},
+    {"boundary - 45 minutes ago", "45 minutes ago", 1704067200, 1704064500, 1704064530, 0, "45 minutes ago", 0},
+    {"boundary - in 2 days", "in 2 days", 1704067200, 1704196800, 1704283200, 0, "in 2 days", 0},
+    {"boundary - 3 months ago", "3 months ago", 1704067200, 1694869200.0000029, 1697497200.0000029, 0, "3 months ago", 0},
+    {"boundary - in 2 years", "in 2 years", 1704067200, 1751414400, 1782907199.9999685, 0, "in 2 years", 0},
+    {"boundary - Yesterday", "Yesterday", 1704067200, 1703980800, 1704067200, 0, "Yesterday", 1},
+};
+
+static const DurationFormatTest DURATION_FORMAT_TESTS[] = {
+    {"default spec matches duration", 3661, WW_UNIT_ALL, 0, 2, 0, NULL, "1 hour, 1 minute", 0},
+    {"hours and minutes only", 266400, WW_UNIT_HOUR | WW_UNIT_MINUTE, 0, 2, 0, NULL, "74 hours", 0},
+    {"hours and minutes only - compact", 5430, WW_UNIT_HOUR | WW_UNIT_MINUTE, 1, 2, 0, NULL, "1h 30m", 0},
+    {"no months", 3888000, WW_UNIT_YEAR | WW_UNIT_DAY | WW_UNIT_HOUR | WW_UNIT_MINUTE | WW_UNIT_SECOND, 0, 2, 0, NULL, "45 days", 0},
+    {"round to nearest largest unit", 5400, WW_UNIT_ALL, 0, 1, 1, NULL, "2 hours", 0},
+    {"nearest rounding carries into the next unit", 7170, WW_UNIT_ALL, 0, 2, 1, NULL, "2 hours", 0},
+    {"floor rounding truncates", 5399, WW_UNIT_ALL, 0, 1, 0, NULL, "1 hour", 0},
+    {"custom separator", 3661, WW_UNIT_ALL, 0, 3, 0, " and ", "1 hour and 1 minute and 1 second", 0},
+    {"zero uses the smallest unit", 20, WW_UNIT_HOUR | WW_UNIT_MINUTE, 0, 2, 0, NULL, "0 minutes", 0},
+    {"nearest rounding of sub-unit input", 40, WW_UNIT_HOUR | WW_UNIT_MINUTE, 0, 2, 1, NULL, "1 minute", 0},
+    {"beyond int64 seconds splits the largest unit in double", 1.0e+19, WW_UNIT_ALL, 0, 2, 0, NULL, "317097919837 years, 7 months", 0},
+    {"beyond int64 seconds - compact with three units", 1.0e+19, WW_UNIT_ALL, 1, 3, 0, NULL, "317097919837y 7mo 25d", 0},
+    {"beyond int64 seconds - nearest rounding carries into the largest unit", 1.0e+19, WW_UNIT_ALL, 0, 1, 1, NULL, "317097919838 years", 0},
+    {"beyond int64 seconds - largest unit is hours", 1.0e+19, WW_UNIT_HOUR | WW_UNIT_MINUTE, 0, 2, 0, NULL, "2777777777777778 hours", 0},
+    {"error - empty unit set", 60, 0, 0, 2, 0, NULL, NULL, 1},
+    {"error - count of the largest unit passes int64", 3.0e+26, WW_UNIT_ALL, 0, 2, 0, NULL, NULL, 1},
+    {"error - negative seconds", -1, WW_UNIT_ALL, 0, 2, 0, NULL, NULL, 1},
+};
+
+static const ClockTest CLOCK_TESTS[] = {
+    {"cached clock - timeago", 0, 1, 1704067200, 1704056400, NULL, "3 hours ago", 0, 0, 0},
+    {"cached clock - human_date", 1, 1, 1704067200, 1703980800, NULL, "Yesterday", 0, 0, 0},
+    {"cached clock - parse_timeago", 2, 1, 1704067200, 0, "in 2 days", NULL, 1704196800, 1704283200, 0},
+    {"clock off - timeago falls back to the timestamp", 0, 0, 1704067200, 1704056400, NULL, "just now", 0, 0, 0},
+    {"clock off - human_date falls back to the timestamp", 1, 0, 1704067200, 1703980800, NULL, "Today", 0, 0, 0},
+    {"error - clock off - parse_timeago needs a reference", 2, 0, 1704067200, 0, "in 2 days", NULL, 0, 0, 1},
+};
+
+static const AppendTest APPEND_TESTS[] = {
+    {"timeago after existing content", 0, WW_ESCAPE_NONE, "seen ", 0, 1704056400, 1704067200, "seen 3 hours ago", 0},
+    {"timeago into a json string", 0, WW_ESCAPE_JSON, "{\"when\":\"", 0, 1704056400, 1704067200, "{\"when\":\"3 hours ago", 0},
+    {"duration into html", 1, WW_ESCAPE_HTML, "<td>", 0, 3661, 0, "<td>1 hour, 1 minute", 0},
+    {"human_date into a json string", 2, WW_ESCAPE_JSON, "", 0, 1709251200, 1704067200, "March 1", 0},
+    {"date_range en dash passes through json", 3, WW_ESCAPE_JSON, "", 0, 1705276800, 1705363200, "January 15–16, 2024", 0},
+    {"date_range en dash passes through html", 3, WW_ESCAPE_HTML, "<p>", 0, 1703721600, 1705276800, "<p>December 28, 2023 – January 15, 2024", 0},
+    {"fixed buffer with room for the terminator", 0, WW_ESCAPE_NONE, "x ", 14, 1704056400, 1704067200, "x 3 hours ago", 0},
+    {"error - fixed buffer one byte short", 0, WW_ESCAPE_NONE, "x ", 13, 1704056400, 1704067200, NULL, 1},
+    {"error - fixed buffer too small for an escaped range", 3, WW_ESCAPE_JSON, "[", 20, 1703721600, 1705276800, NULL, 1},
+    {"error - fixed buffer too small for a duration", 1, WW_ESCAPE_HTML, "<td>", 12, 3661, 0, NULL, 1},
+    {"duration beyond int64 seconds", 1, WW_ESCAPE_NONE, "", 0, 1.0e+19, 0, "317097919837 years, 7 months", 0},
+    {"error - invalid input leaves a growable buffer unchanged", 1, WW_ESCAPE_JSON, "\"", 0, -1, 0, NULL, 1},
+};
+
+static const BatchRow BATCH_ROWS_0[] = {
+    {{WW_TS_UNIX, 1704056400, NULL}, "3 hours ago"},
+    {{WW_TS_ISO, 0, "2023-12-31T21:00:00"}, "3 hours ago"},
+    {{WW_TS_NONE, 0, NULL}, ""},
+    {{WW_TS_ISO, 0, "not a date"}, ""},
+    {{WW_TS_UNIX, 1704067200, NULL}, "just now"},
+};
+
+static const BatchRow BATCH_ROWS_1[] = {
+    {{WW_TS_UNIX, 1703980800, NULL}, "Yesterday"},
+    {{WW_TS_ISO, 0, "2024-03-01"}, "March 1"},
+    {{WW_TS_NONE, 0, NULL}, ""},
+    {{WW_TS_UNIX, 1704067200, NULL}, "Today"},
+};
+
+static const BatchRow BATCH_ROWS_2[] = {
+    {{WW_TS_UNIX, 1704056400, NULL}, "just now"},
+    {{WW_TS_NONE, 0, NULL}, ""},
+};
+
+static const BatchTest BATCH_TESTS[] = {
+    {"timeago rows with unset and invalid iso input", 0, 1, 1704067200, BATCH_ROWS_0, 5, 3},
+    {"human_date rows", 1, 1, 1704067200, BATCH_ROWS_1, 4, 3},
+    {"timeago with an unset reference uses each row", 0, 0, 0, BATCH_ROWS_2, 2, 1},
+    {"empty batch", 1, 1, 1704067200, NULL, 0, 0},
+};
+
+static const int64_t COLUMN_VALUES_0[] = {1704056400000, 1704067199999, 1704067245000};
+static const char *const COLUMN_ROWS_0[] = {"3 hours ago", "just now", "in 1 minute"};
+
+static const int64_t COLUMN_VALUES_1[] = {-44999, -45000};
+static const char *const COLUMN_ROWS_1[] = {"just now", "1 minute ago"};
+
+static const int64_t COLUMN_VALUES_2[] = {5400000000000, 1999999999, -1};
+static const char *const COLUMN_ROWS_2[] = {"1 hour, 30 minutes", "1 second", NULL};
+
+static const double COLUMN_VALUES_3[] = {0, 3661, -5, 60, 7200};
+static const uint8_t COLUMN_VALIDITY_3[] = {0x17};
+static const char *const COLUMN_ROWS_3[] = {"1 hour, 1 minute", NULL, NULL, "2 hours"};
+
+static const int64_t COLUMN_VALUES_4[] = {0, 0, 1703980800000, 1704067200000, 1709251200500, 0, 0, 0, 0, 1704153600000};
+static const uint8_t COLUMN_VALIDITY_4[] = {0xf4, 0x02};
+static const char *const COLUMN_ROWS_4[] = {"Yesterday", NULL, "March 1", "January 1, 1970", "January 1, 1970", "January 1, 1970", NULL, "Tomorrow"};
+
+static const int64_t COLUMN_VALUES_6[] = {1704067200000};
+
+static const int64_t COLUMN_VALUES_7[] = {1704067200000};
+
+static const ColumnTest COLUMN_TESTS[] = {
+    {"milliseconds to timeago", 0, COLUMN_VALUES_0, NULL, NULL, 0, 3, 1000, 1704067200, COLUMN_ROWS_0, 0},
+    {"negative milliseconds keep their fraction", 0, COLUMN_VALUES_1, NULL, NULL, 0, 2, 1000, 0, COLUMN_ROWS_1, 0},
+    {"nanoseconds to duration", 2, COLUMN_VALUES_2, NULL, NULL, 0, 3, 1000000000, 0, COLUMN_ROWS_2, 0},
+    {"double seconds with an offset into values and validity", 2, NULL, COLUMN_VALUES_3, COLUMN_VALIDITY_3, 1, 4, 1, 0, COLUMN_ROWS_3, 0},
+    {"int64 milliseconds with an offset into values and validity", 1, COLUMN_VALUES_4, NULL, COLUMN_VALIDITY_4, 2, 8, 1000, 1704067200, COLUMN_ROWS_4, 0},
+    {"empty column", 2, NULL, NULL, NULL, 0, 0, 1, 0, NULL, 0},
+    {"error - zero ticks per second", 1, COLUMN_VALUES_6, NULL, NULL, 0, 1, 0, 1704067200, NULL, 1},
+    {"error - negative ticks per second", 0, COLUMN_VALUES_7, NULL, NULL, 0, 1, -1000, 1704067200, NULL, 1},
+};
+
+static const CalendarSpan CALENDAR_SPANS_0[] = {
+    {{19781, 2024, 2, 28, 3}, {19781, 2024, 2, 28, 3}, "February 28, 2024"},
+    {{19782, 2024, 2, 29, 4}, {19782, 2024, 2, 29, 4}, "February 29, 2024"},
+    {{19783, 2024, 3, 1, 5}, {19783, 2024, 3, 1, 5}, "March 1, 2024"},
+};
+
+static const CalendarSpan CALENDAR_SPANS_1[] = {
+    {{19416, 2023, 2, 28, 2}, {19416, 2023, 2, 28, 2}, "February 28, 2023"},
+    {{19417, 2023, 3, 1, 3}, {19417, 2023, 3, 1, 3}, "March 1, 2023"},
+};
+
+static const CalendarSpan CALENDAR_SPANS_2[] = {
+    {{19786, 2024, 3, 4, 1}, {19792, 2024, 3, 10, 0}, "March 4–10, 2024"},
+    {{19793, 2024, 3, 11, 1}, {19799, 2024, 3, 17, 0}, "March 11–17, 2024"},
+    {{19800, 2024, 3, 18, 1}, {19802, 2024, 3, 20, 3}, "March 18–20, 2024"},
+};
+
+static const CalendarSpan CALENDAR_SPANS_3[] = {
+    {{19718, 2023, 12, 27, 3}, {19724, 2024, 1, 2, 2}, "December 27, 2023 – January 2, 2024"},
+    {{19725, 2024, 1, 3, 3}, {19727, 2024, 1, 5, 5}, "January 3–5, 2024"},
+};
+
+static const CalendarSpan CALENDAR_SPANS_4[] = {
+    {{19779, 2024, 2, 26, 1}, {19782, 2024, 2, 29, 4}, "February 26–29, 2024"},
+    {{19783, 2024, 3, 1, 5}, {19813, 2024, 3, 31, 0}, "March 1–31, 2024"},
+    {{19814, 2024, 4, 1, 1}, {19816, 2024, 4, 3, 3}, "April 1–3, 2024"},
+};
+
+static const CalendarSpan CALENDAR_SPANS_5[] = {
+    {{19706, 2023, 12, 15, 5}, {19722, 2023, 12, 31, 0}, "December 15–31, 2023"},
+    {{19723, 2024, 1, 1, 1}, {19753, 2024, 1, 31, 3}, "January 1–31, 2024"},
+    {{19754, 2024, 2, 1, 4}, {19763, 2024, 2, 10, 6}, "February 1–10, 2024"},
+};
+
+static const CalendarSpan CALENDAR_SPANS_6[] = {
+    {{19706, 2023, 12, 15, 5}, {19722, 2023, 12, 31, 0}, "December 15–31, 2023"},
+    {{19723, 2024, 1, 1, 1}, {19753, 2024, 1, 31, 3}, "January 1–31, 2024"},
+    {{19754, 2024, 2, 1, 4}, {19782, 2024, 2, 29, 4}, "February 1–29, 2024"},
+    {{19783, 2024, 3, 1, 5}, {19784, 2024, 3, 2, 6}, "March 1–2, 2024"},
+};
+
+static const CalendarSpan CALENDAR_SPANS_7[] = {
+    {{19783, 2024, 3, 1, 5}, {19783, 2024, 3, 1, 5}, "March 1, 2024"},
+    {{19784, 2024, 3, 2, 6}, {19784, 2024, 3, 2, 6}, "March 2, 2024"},
+    {{19785, 2024, 3, 3, 0}, {19785, 2024, 3, 3, 0}, "March 3, 2024"},
+};
+
+static const CalendarSpan CALENDAR_SPANS_8[] = {
+    {{19783, 2024, 3, 1, 5}, {19783, 2024, 3, 1, 5}, "March 1, 2024"},
+};
+
+static const CalendarSpan CALENDAR_SPANS_9[] = {
+    {{19783, 2024, 3, 1, 5}, {19783, 2024, 3, 1, 5}, ""},
+};
+
+static const CalendarTest CALENDAR_TESTS[] = {
+    {"days across a leap day", {WW_TS_ISO, 0, "2024-02-28"}, {WW_TS_ISO, 0, "2024-03-01T12:00:00"}, WW_STEP_DAY, 64, CALENDAR_SPANS_0, 3, 0},
+    {"days across the end of February in a common year", {WW_TS_ISO, 0, "2023-02-28"}, {WW_TS_ISO, 0, "2023-03-01"}, WW_STEP_DAY, 64, CALENDAR_SPANS_1, 2, 0},
+    {"weeks clipped to the range", {WW_TS_ISO, 0, "2024-03-04"}, {WW_TS_ISO, 0, "2024-03-20"}, WW_STEP_WEEK, 64, CALENDAR_SPANS_2, 3, 0},
+    {"week across the new year", {WW_TS_ISO, 0, "2023-12-27"}, {WW_TS_ISO, 0, "2024-01-05"}, WW_STEP_WEEK, 64, CALENDAR_SPANS_3, 2, 0},
+    {"months in a leap year", {WW_TS_ISO, 0, "2024-02-26"}, {WW_TS_ISO, 0, "2024-04-03"}, WW_STEP_MONTH, 64, CALENDAR_SPANS_4, 3, 0},
+    {"months across the new year", {WW_TS_ISO, 0, "2023-12-15"}, {WW_TS_ISO, 0, "2024-02-10"}, WW_STEP_MONTH, 64, CALENDAR_SPANS_5, 3, 0},
+    {"months from a common year into a leap February", {WW_TS_ISO, 0, "2023-12-15"}, {WW_TS_ISO, 0, "2024-03-02"}, WW_STEP_MONTH, 64, CALENDAR_SPANS_6, 4, 0},
+    {"reversed inputs are swapped", {WW_TS_UNIX, 1709424000, NULL}, {WW_TS_UNIX, 1709251200, NULL}, WW_STEP_DAY, 64, CALENDAR_SPANS_7, 3, 0},
+    {"label that exactly fits", {WW_TS_ISO, 0, "2024-03-01"}, {WW_TS_ISO, 0, "2024-03-01"}, WW_STEP_MONTH, 14, CALENDAR_SPANS_8, 1, 0},
+    {"label one byte too small is empty", {WW_TS_ISO, 0, "2024-03-01"}, {WW_TS_ISO, 0, "2024-03-01"}, WW_STEP_MONTH, 13, CALENDAR_SPANS_9, 1, 0},
+    {"error - NaN start", {WW_TS_UNIX, NAN, NULL}, {WW_TS_UNIX, 0, NULL}, WW_STEP_MONTH, 64, NULL, 0, 1},
+    {"error - infinite end", {WW_TS_UNIX, 0, NULL}, {WW_TS_UNIX, HUGE_VAL, NULL}, WW_STEP_DAY, 64, NULL, 0, 1},
+    {"error - unparseable iso start", {WW_TS_ISO, 0, "not a date"}, {WW_TS_UNIX, 0, NULL}, WW_STEP_WEEK, 64, NULL, 0, 1},
+    {"error - start whose year does not fit", {WW_TS_UNIX, -1.0e+300, NULL}, {WW_TS_UNIX, 0, NULL}, WW_STEP_MONTH, 64, NULL, 0, 1},
+    {"error - end just past the supported range", {WW_TS_UNIX, 0, NULL}, {WW_TS_UNIX, 6.8e+16, NULL}, WW_STEP_DAY, 64, NULL, 0, 1},
+};
+
+static const DescribeTest DESCRIBE_TESTS[] = {
+    {"all three views", "", 0, 1705276800, 1704067200, {WW_TS_UNIX, 1707955200, NULL}, WW_DESCRIBE_TIMEAGO | WW_DESCRIBE_HUMAN_DATE | WW_DESCRIBE_DATE_RANGE, {"in 14 days", "January 15", "January 15 – February 15, 2024"}, {{0, 10}, {10, 10}, {20, 32}}, 0},
+    {"timeago and date_range after existing content", "row: ", 0, 1705276800, 1704067200, {WW_TS_UNIX, 1707955200, NULL}, WW_DESCRIBE_TIMEAGO | WW_DESCRIBE_DATE_RANGE, {"in 14 days", NULL, "January 15 – February 15, 2024"}, {{5, 10}, {0, 0}, {15, 32}}, 0},
+    {"human_date only", "", 0, 1703980800, 1704067200, {WW_TS_NONE, 0, NULL}, WW_DESCRIBE_HUMAN_DATE, {NULL, "Yesterday", NULL}, {{0, 0}, {0, 9}, {0, 0}}, 0},
+    {"unset end gives a single day", "", 0, 1705276800, 1704067200, {WW_TS_NONE, 0, NULL}, WW_DESCRIBE_DATE_RANGE, {NULL, NULL, "January 15, 2024"}, {{0, 0}, {0, 0}, {0, 16}}, 0},
+    {"no views", "x", 0, 1705276800, 1704067200, {WW_TS_NONE, 0, NULL}, 0, {NULL, NULL, NULL}, {{0, 0}, {0, 0}, {0, 0}}, 0},
+    {"error - later view does not fit a fixed buffer", "", 24, 1705276800, 1704067200, {WW_TS_UNIX, 1707955200, NULL}, WW_DESCRIBE_TIMEAGO | WW_DESCRIBE_HUMAN_DATE | WW_DESCRIBE_DATE_RANGE, {NULL, NULL, NULL}, {{0, 0}, {0, 0}, {0, 0}}, 1},
+    {"error - invalid end", "x", 0, 1705276800, 1704067200, {WW_TS_ISO, 0, "not a date"}, WW_DESCRIBE_TIMEAGO, {NULL, NULL, NULL}, {{0, 0}, {0, 0}, {0, 0}}, 1},
+};
+
 static int expect_string(const char *name, const char *got, const char *expected, int expect_error) {
     if (expect_error) {
         if (got != NULL) {
@@ -224,6 +597,318 @@ static int expect_number(const char *name, int ok, double got, double expected,
     return 0;
 }
 
+static int expect_render(const char *name, const ParseTimeagoTest *t, double ts, int match) {
+    ww_timestamp stamp = ww_timestamp_from_unix(ts);
+    ww_timestamp ref = ww_timestamp_from_unix(t->reference);
+    char *got = t->human_date ? human_date(stamp, ref) : timeago(stamp, ref);
+    int failed = got == NULL || (strcmp(got, t->render) == 0) != match;
+    if (failed) {
+        fprintf(stderr, "FAIL: %s (%.9f renders '%s', expected %s'%s')\n", name, ts, got ? got : "(error)",
+                match ? "" : "not ", t->render);
+    }
+    free(got);
+    return failed;
+}
+
+/* Returns a buffer already holding `prefix`: fixed over `storage` when
+ * `capacity` is non-zero, otherwise growable and heap-allocated. */
+static ww_buf test_buffer(const char *prefix, char *storage, size_t capacity) {
+    size_t len = strlen(prefix);
+    ww_buf buf = capacity > 0 ? ww_buf_init(storage, capacity, NULL)
+                              : ww_buf_init((char *)malloc(len + 1), len + 1, realloc);
+    memcpy(buf.ptr, prefix, len + 1);
+    buf.len = len;
+    return buf;
+}
+
+static int run_append(const AppendTest *t) {
+    char storage[256];
+    ww_buf buf = test_buffer(t->prefix, storage, t->capacity);
+    ww_timestamp first = ww_timestamp_from_unix(t->first);
+    ww_timestamp second = ww_timestamp_from_unix(t->second);
+    bool ok = false;
+    if (t->function == 0) {
+        ok = timeago_append(&buf, t->mode, first, second);
+    } else if (t->function == 1) {
+        ok = duration_append(&buf, t->mode, t->first, NULL);
+    } else if (t->function == 2) {
+        ok = human_date_append(&buf, t->mode, first, second);
+    } else {
+        ok = date_range_append(&buf, t->mode, first, second);
+    }
+    const char *expected = t->error ? t->prefix : t->output;
+    int failed = ok == (bool)t->error || buf.len != strlen(expected) || strcmp(buf.ptr, expected) != 0;
+    if (failed) {
+        fprintf(stderr, "FAIL: %s (returned %d with '%s', expected %d with '%s')\n", t->name, ok, buf.ptr,
+                !t->error, expected);
+    }
+    if (t->capacity == 0) {
+        free(buf.ptr);
+    }
+    return failed;
+}
+
+static ww_timestamp timestamp_from_input(const TimestampInput *input) {
+    if (input->kind == WW_TS_ISO) {
+        return ww_timestamp_from_iso(input->iso);
+    }
+    return input->kind == WW_TS_UNIX ? ww_timestamp_from_unix(input->unix_seconds) : ww_timestamp_unset();
+}
+
+/* Checks n + 1 offsets into `buf` that start after `mark`, and each row's text. */
+static int expect_rows(const char *name, const ww_buf *buf, size_t mark, const size_t *offsets,
+                       const BatchRow *rows, size_t n) {
+    if (offsets[0] != mark || offsets[n] != buf->len) {
+        fprintf(stderr, "FAIL: %s (offsets span %zu..%zu, buffer spans %zu..%zu)\n", name, offsets[0], offsets[n],
+                mark, buf->len);
+        return 1;
+    }
+    int failures = 0;
+    for (size_t i = 0; i < n; i++) {
+        size_t len = offsets[i + 1] - offsets[i];
+        if (offsets[i + 1] < offsets[i] || len != strlen(rows[i].output) ||
+            memcmp(buf->ptr + offsets[i], rows[i].output, len) != 0) {
+            fprintf(stderr, "FAIL: %s row %zu (expected '%s')\n", name, i, rows[i].output);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+static int run_batch(const BatchTest *t) {
+    ww_timestamp inputs[BATCH_MAX_ROWS];
+    ww_packed_ts packed[BATCH_MAX_ROWS];
+    size_t offsets[BATCH_MAX_ROWS + 1];
+    for (size_t i = 0; i < t->count; i++) {
+        inputs[i] = timestamp_from_input(&t->rows[i].first);
+    }
+    int failures = 0;
+    size_t valid = ww_timestamp_pack_array(inputs, t->count, packed);
+    if (valid != t->valid) {
+        fprintf(stderr, "FAIL: %s (packed %zu valid, expected %zu)\n", t->name, valid, t->valid);
+        failures++;
+    }
+    for (size_t i = 0; i < t->count; i++) {
+        if (ww_packed_is_set(packed[i]) != (t->rows[i].output[0] != '\0')) {
+            fprintf(stderr, "FAIL: %s row %zu (wrong NaN tag)\n", t->name, i);
+            failures++;
+        }
+    }
+    ww_buf buf = test_buffer("#", NULL, 0);
+    ww_packed_ts reference = t->has_reference ? t->reference : NAN;
+    bool ok = t->function == 0 ? timeago_batch(&buf, WW_ESCAPE_NONE, packed, t->count, reference, offsets)
+                               : human_date_batch(&buf, WW_ESCAPE_NONE, packed, t->count, reference, offsets);
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s (batch returned false)\n", t->name);
+        failures++;
+    } else {
+        failures += expect_rows(t->name, &buf, 1, offsets, t->rows, t->count);
+    }
+    free(buf.ptr);
+    return failures;
+}
+
+static int run_column(const ColumnTest *t) {
+    ww_column column = t->i64 ? ww_column_from_int64(t->i64, t->validity, t->length, t->ticks_per_second)
+                              : ww_column_from_double(t->f64, t->validity, t->length);
+    column.offset = t->offset;
+    int32_t offsets[COLUMN_MAX_ROWS + 1];
+    uint8_t validity[COLUMN_MAX_ROWS / 8] = {0xaa, 0xaa};
+    ww_buf data = ww_buf_init(NULL, 0, realloc);
+    bool ok = false;
+    if (t->function == 0) {
+        ok = timeago_column(&column, t->reference, &data, offsets, validity);
+    } else if (t->function == 1) {
+        ok = human_date_column(&column, t->reference, &data, offsets, validity);
+    } else {
+        ok = duration_column(&column, NULL, &data, offsets, validity);
+    }
+    int failures = 0;
+    if (ok == (bool)t->error) {
+        fprintf(stderr, "FAIL: %s (returned %d)\n", t->name, ok);
+        failures++;
+    } else if (ok && (offsets[0] != 0 || offsets[t->length] != (int32_t)data.len)) {
+        fprintf(stderr, "FAIL: %s (offsets span %d..%d for %zu bytes)\n", t->name, offsets[0],
+                offsets[t->length], data.len);
+        failures++;
+    } else if (ok) {
+        for (size_t i = 0; i < t->length; i++) {
+            const char *expected = t->rows[i] ? t->rows[i] : "";
+            size_t len = (size_t)(offsets[i + 1] - offsets[i]);
+            bool bit = (validity[i / 8] >> (i % 8)) & 1u;
+            if (offsets[i + 1] < offsets[i] || bit != (t->rows[i] != NULL) || len != strlen(expected) ||
+                memcmp(data.ptr + offsets[i], expected, len) != 0) {
+                fprintf(stderr, "FAIL: %s row %zu (expected %s'%s')\n", t->name, i, t->rows[i] ? "" : "null ",
+                        expected);
+                failures++;
+            }
+        }
+    }
+    free(data.ptr);
+    return failures;
+}
+
+static int same_date(const ww_date *a, const ww_date *b) {
+    return a->days == b->days && a->year == b->year && a->month == b->month && a->day == b->day &&
+           a->weekday == b->weekday;
+}
+
+static int run_calendar(const CalendarTest *t) {
+    ww_calendar_iter it;
+    bool ok = ww_calendar_iter_init(&it, timestamp_from_input(&t->start), timestamp_from_input(&t->end), t->step);
+    if (ok == (bool)t->error) {
+        fprintf(stderr, "FAIL: %s (init returned %d)\n", t->name, ok);
+        return 1;
+    }
+    int failures = 0;
+    for (size_t i = 0; ok && i <= t->count; i++) {
+        ww_date first;
+        ww_date last;
+        char label[64];
+        memset(label, 'x', sizeof(label));
+        bool more = ww_calendar_iter_next(&it, &first, &last, label, t->label_size);
+        if (i == t->count) {
+            if (more) {
+                fprintf(stderr, "FAIL: %s (extra span '%s')\n", t->name, label);
+                failures++;
+            }
+        } else if (!more || !same_date(&first, &t->spans[i].first) || !same_date(&last, &t->spans[i].last) ||
+                   strcmp(label, t->spans[i].label) != 0) {
+            fprintf(stderr, "FAIL: %s span %zu (expected '%s')\n", t->name, i, t->spans[i].label);
+            failures++;
+            break;
+        }
+    }
+    return failures;
+}
+
+static int same_span(const ww_span *a, const ww_span *b) {
+    return a->offset == b->offset && a->length == b->length;
+}
+
+static int run_describe(const DescribeTest *t) {
+    char storage[256];
+    ww_buf buf = test_buffer(t->prefix, storage, t->capacity);
+    ww_description got;
+    memset(&got, 0xff, sizeof(got));
+    bool ok = ww_describe(&buf, WW_ESCAPE_NONE, ww_timestamp_from_unix(t->timestamp),
+                          ww_timestamp_from_unix(t->reference), timestamp_from_input(&t->end), t->flags, &got);
+    int failed = ok == (bool)t->error || !same_span(&got.timeago, &t->expected.timeago) ||
+                 !same_span(&got.human_date, &t->expected.human_date) ||
+                 !same_span(&got.date_range, &t->expected.date_range);
+    const ww_span *spans[3] = {&got.timeago, &got.human_date, &got.date_range};
+    size_t end = strlen(t->prefix);
+    for (size_t i = 0; i < 3 && !failed; i++) {
+        if (t->views[i]) {
+            failed = memcmp(buf.ptr + spans[i]->offset, t->views[i], spans[i]->length) != 0;
+            end = spans[i]->offset + spans[i]->length;
+        }
+    }
+    if (!failed && (buf.len != end || strncmp(buf.ptr, t->prefix, strlen(t->prefix)) != 0)) {
+        failed = 1;
+    }
+    if (failed) {
+        fprintf(stderr, "FAIL: %s (returned %d with '%s')\n", t->name, ok, buf.ptr);
+    }
+    if (t->capacity == 0) {
+        free(buf.ptr);
+    }
+    return failed;
+}
+
+#define DATE_RANGE_COUNT (sizeof(DATE_RANGE_TESTS) / sizeof(DATE_RANGE_TESTS[0]))
+#define DATE_RANGE_BATCH_ROUNDS 8
+#define DATE_RANGE_BATCH_ROWS (DATE_RANGE_BATCH_ROUNDS * (DATE_RANGE_COUNT + 2))
+
+/* Runs every date_range case through date_range_batch, repeated so the
+ * batch spans more than one internal block, with a NaN end and a NaN start
+ * after each round. */
+static int run_date_range_batch(void) {
+    static ww_packed_ts starts[DATE_RANGE_BATCH_ROWS];
+    static ww_packed_ts ends[DATE_RANGE_BATCH_ROWS];
+    static BatchRow rows[DATE_RANGE_BATCH_ROWS];
+    static size_t offsets[DATE_RANGE_BATCH_ROWS + 1];
+    size_t n = 0;
+    for (size_t round = 0; round < DATE_RANGE_BATCH_ROUNDS; round++) {
+        for (size_t i = 0; i < DATE_RANGE_COUNT; i++) {
+            const DateRangeTest *t = &DATE_RANGE_TESTS[i];
+            starts[n] = t->start;
+            ends[n] = t->end;
+            rows[n++].output = t->error ? "" : t->output;
+        }
+        starts[n] = DATE_RANGE_TESTS[0].start;
+        ends[n] = NAN;
+        rows[n++].output = "";
+        starts[n] = NAN;
+        ends[n] = DATE_RANGE_TESTS[0].end;
+        rows[n++].output = "";
+    }
+    ww_buf buf = test_buffer("#", NULL, 0);
+    int failures = 0;
+    if (!date_range_batch(&buf, WW_ESCAPE_NONE, starts, ends, n, offsets)) {
+        fprintf(stderr, "FAIL: date_range_batch (returned false)\n");
+        failures++;
+    } else {
+        failures += expect_rows("date_range_batch", &buf, 1, offsets, rows, n);
+    }
+    free(buf.ptr);
+    buf = test_buffer("#", NULL, 0);
+    offsets[0] = 99;
+    if (!date_range_batch(&buf, WW_ESCAPE_NONE, NULL, NULL, 0, offsets) || offsets[0] != 1 || buf.len != 1) {
+        fprintf(stderr, "FAIL: date_range_batch (empty batch)\n");
+        failures++;
+    }
+    free(buf.ptr);
+    return failures;
+}
+
+static int run_parse_duration_tests(void) {
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(PARSE_DURATION_TESTS) / sizeof(PARSE_DURATION_TESTS[0]); i++) {
+        const ParseDurationTest *t = &PARSE_DURATION_TESTS[i];
+        double value = 0.0;
+        int ok = parse_duration(t->input, &value);
+        failures += expect_number(t->name, ok, value, t->output, t->error);
+    }
+    for (size_t i = 0; i < sizeof(PARSE_DURATION_GRAMMAR_TESTS) / sizeof(PARSE_DURATION_GRAMMAR_TESTS[0]); i++) {
+        const ParseDurationTest *t = &PARSE_DURATION_GRAMMAR_TESTS[i];
+        double value = 0.0;
+        int ok = parse_duration(t->input, &value);
+        failures += expect_number(t->name, ok, value, t->output, t->error);
+    }
+    for (size_t i = 0; i < sizeof(PARSE_DURATION_NS_TESTS) / sizeof(PARSE_DURATION_NS_TESTS[0]); i++) {
+        const ParseDurationTest *t = &PARSE_DURATION_NS_TESTS[i];
+        int64_t value = 0;
+        int ok = parse_duration_ns(t->input, &value);
+        failures += expect_number(t->name, ok, (double)value, t->output, t->error);
+    }
+    return failures;
+}
+
+/* Re-runs the duration parser cases under the first installed LC_NUMERIC
+ * locale whose decimal point is not '.', trying $WW_TEST_LOCALE first. */
+static int run_locale_tests(void) {
+    const char *candidates[] = {getenv("WW_TEST_LOCALE"), "de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8",
+                                "fr_FR.utf8", "de_DE", "fr_FR"};
+    const char *name = NULL;
+    for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]) && !name; i++) {
+        if (candidates[i] && setlocale(LC_NUMERIC, candidates[i]) && strcmp(localeconv()->decimal_point, ".") != 0) {
+            name = candidates[i];
+        }
+    }
+    if (!name) {
+        setlocale(LC_NUMERIC, "C");
+        printf("Skipped locale tests: no comma-decimal locale installed (set WW_TEST_LOCALE).\n");
+        return 0;
+    }
+    int failures = run_parse_duration_tests();
+    setlocale(LC_NUMERIC, "C");
+    if (failures > 0) {
+        fprintf(stderr, "FAIL: %d duration parser cases under LC_NUMERIC=%s\n", failures, name);
+    }
+    return failures;
+}
+
 int main(void) {
     int failures = 0;
 
@@ -251,12 +936,7 @@ int main(void) {
         failures += expect_string(t->name, result, t->output, t->error);
     }
 
-    for (size_t i = 0; i < sizeof(PARSE_DURATION_TESTS) / sizeof(PARSE_DURATION_TESTS[0]); i++) {
-        const ParseDurationTest *t = &PARSE_DURATION_TESTS[i];
-        double value = 0.0;
-        int ok = parse_duration(t->input, &value);
-        failures += expect_number(t->name, ok, value, t->output, t->error);
-    }
+    failures += run_parse_duration_tests();
 
     for (size_t i = 0; i < sizeof(HUMAN_DATE_TESTS) / sizeof(HUMAN_DATE_TESTS[0]); i++) {
         const HumanDateTest *t = &HUMAN_DATE_TESTS[i];
@@ -270,6 +950,87 @@ int main(void) {
         failures += expect_string(t->name, result, t->output, t->error);
     }
 
+    failures += run_locale_tests();
+
+    for (size_t i = 0; i < sizeof(PARSE_TIMEAGO_TESTS) / sizeof(PARSE_TIMEAGO_TESTS[0]); i++) {
+        const ParseTimeagoTest *t = &PARSE_TIMEAGO_TESTS[i];
+        double lo = 0.0;
+        double hi = 0.0;
+        int ok = parse_timeago(t->input, ww_timestamp_from_unix(t->reference), &lo, &hi);
+        failures += expect_number(t->name, ok, lo, t->lo, t->error);
+        if (ok && !t->error) {
+            failures += expect_number(t->name, ok, hi, t->hi, t->error);
+        }
+        if (ok && t->render) {
+            failures += expect_render(t->name, t, lo, 1);
+            failures += expect_render(t->name, t, nextafter(hi, -HUGE_VAL), 1);
+            failures += expect_render(t->name, t, hi, 0);
+            failures += expect_render(t->name, t, nextafter(lo, -HUGE_VAL), 0);
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(DURATION_FORMAT_TESTS) / sizeof(DURATION_FORMAT_TESTS[0]); i++) {
+        const DurationFormatTest *t = &DURATION_FORMAT_TESTS[i];
+        ww_duration_spec spec = ww_duration_spec_default();
+        spec.units = t->units;
+        spec.compact = t->compact;
+        spec.max_units = t->max_units;
+        spec.rounding = t->nearest ? WW_DURATION_ROUND_NEAREST : WW_DURATION_ROUND_FLOOR;
+        spec.separator = t->separator;
+        ww_duration_plan plan;
+        ww_buf buf = ww_buf_init(NULL, 0, realloc);
+        char *result = NULL;
+        if (ww_duration_format_compile(&spec, &plan) && ww_duration_format_exec(&plan, t->seconds, &buf)) {
+            result = buf.ptr;
+        } else {
+            free(buf.ptr);
+        }
+        failures += expect_string(t->name, result, t->output, t->error);
+    }
+
+    for (size_t i = 0; i < sizeof(CLOCK_TESTS) / sizeof(CLOCK_TESTS[0]); i++) {
+        const ClockTest *t = &CLOCK_TESTS[i];
+        ww_clock_set_mode(t->cached ? WW_CLOCK_CACHED : WW_CLOCK_OFF);
+        ww_clock_set(t->now);
+        ww_timestamp stamp = ww_timestamp_from_unix(t->timestamp);
+        if (t->function == 0) {
+            failures += expect_string(t->name, timeago(stamp, ww_timestamp_unset()), t->output, t->error);
+        } else if (t->function == 1) {
+            failures += expect_string(t->name, human_date(stamp, ww_timestamp_unset()), t->output, t->error);
+        } else {
+            double lo = 0.0;
+            double hi = 0.0;
+            int ok = parse_timeago(t->text, ww_timestamp_unset(), &lo, &hi);
+            failures += expect_number(t->name, ok, lo, t->lo, t->error);
+            if (ok && !t->error) {
+                failures += expect_number(t->name, ok, hi, t->hi, t->error);
+            }
+        }
+    }
+    ww_clock_set_mode(WW_CLOCK_OFF);
+
+    for (size_t i = 0; i < sizeof(APPEND_TESTS) / sizeof(APPEND_TESTS[0]); i++) {
+        failures += run_append(&APPEND_TESTS[i]);
+    }
+
+    for (size_t i = 0; i < sizeof(BATCH_TESTS) / sizeof(BATCH_TESTS[0]); i++) {
+        failures += run_batch(&BATCH_TESTS[i]);
+    }
+
+    for (size_t i = 0; i < sizeof(COLUMN_TESTS) / sizeof(COLUMN_TESTS[0]); i++) {
+        failures += run_column(&COLUMN_TESTS[i]);
+    }
+
+    for (size_t i = 0; i < sizeof(CALENDAR_TESTS) / sizeof(CALENDAR_TESTS[0]); i++) {
+        failures += run_calendar(&CALENDAR_TESTS[i]);
+    }
+
+    for (size_t i = 0; i < sizeof(DESCRIBE_TESTS) / sizeof(DESCRIBE_TESTS[0]); i++) {
+        failures += run_describe(&DESCRIBE_TESTS[i]);
+    }
+
+    failures += run_date_range_batch();
+
     if (failures == 0) {
         printf("All tests passed.\n");
         return 0;
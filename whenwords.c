@@ -1,6 +1,7 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "whenwords.h"
 
-#include <ctype.h>
 #include <math.h>
 #include <stdarg.h>
 #include <stdint.h>
@@ -14,6 +15,44 @@
 #define WW_SECONDS_PER_MONTH (30.0 * WW_SECONDS_PER_DAY)
 #define WW_SECONDS_PER_YEAR (365.0 * WW_SECONDS_PER_DAY)
 
+#define WW_CACHE_LINE_SIZE 64
+
+#if defined(__GNUC__) || defined(__clang__)
+#define WW_CACHE_ALIGNED __attribute__((aligned(WW_CACHE_LINE_SIZE)))
+#define WW_ATOMIC_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define WW_ATOMIC_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#else
+#define WW_CACHE_ALIGNED
+#define WW_ATOMIC_LOAD(p) (*(p))
+#define WW_ATOMIC_STORE(p, v) (*(p) = (v))
+#endif
+
+/* Static tracepoints. Build with -DWW_ENABLE_SDT (needs <sys/sdt.h> from
+ * systemtap-sdt-dev) to emit USDT probes under the "whenwords" provider;
+ * otherwise they compile away. Each probe is a single nop until attached. */
+#if defined(WW_ENABLE_SDT)
+#include <sys/sdt.h>
+#define WW_PROBE1(name, a) DTRACE_PROBE1(whenwords, name, a)
+#define WW_PROBE2(name, a, b) DTRACE_PROBE2(whenwords, name, a, b)
+#else
+#define WW_PROBE1(name, a) ((void)sizeof(a))
+#define WW_PROBE2(name, a, b) ((void)sizeof(a), (void)sizeof(b))
+#endif
+
+/* call__entry(function, input kind) and call__return(function, output length).
+ * The kind is a ww_timestamp_kind, or -1 for inputs that are not timestamps.
+ * The length is -1 on error and 0 for parsers. */
+#define WW_TRACE_NO_KIND (-1)
+#define WW_TRACE_ENTRY(kind) WW_PROBE2(call__entry, (const char *)__func__, (int)(kind))
+#define WW_TRACE_RETURN(len) WW_PROBE2(call__return, (const char *)__func__, (long)(len))
+#define WW_TRACE_LEN(ok, len) ((ok) ? (long)(len) : -1L)
+
+#if defined(CLOCK_REALTIME_COARSE)
+#define WW_CLOCK_SOURCE CLOCK_REALTIME_COARSE
+#elif defined(CLOCK_REALTIME)
+#define WW_CLOCK_SOURCE CLOCK_REALTIME
+#endif
+
 static const char *ww_month_names[] = {
     "January", "February", "March", "April", "May", "June",
     "July", "August", "September", "October", "November", "December"};
@@ -21,32 +60,276 @@ static const char *ww_month_names[] = {
 static const char *ww_weekday_names[] = {
     "Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"};
 
-static char *ww_strdup(const char *s) {
-    size_t len = strlen(s);
-    char *out = (char *)malloc(len + 1);
-    if (!out) {
-        return NULL;
+/* ASCII byte classes shared by every parser, used instead of <ctype.h>,
+ * whose functions consult the thread's locale on each call. Bytes >= 0x80
+ * have no class. */
+#define WW_CHAR_SPACE 0x01u
+#define WW_CHAR_DIGIT 0x02u
+#define WW_CHAR_LOWER 0x04u
+#define WW_CHAR_UPPER 0x08u
+#define WW_CHAR_ALPHA (WW_CHAR_LOWER | WW_CHAR_UPPER)
+
+#define S WW_CHAR_SPACE
+#define D WW_CHAR_DIGIT
+#define L WW_CHAR_LOWER
+#define U WW_CHAR_UPPER
+
+static const unsigned char ww_char_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, S, S, S, S, S, 0, 0, /* 0x00 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 0x10 */
+    S, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 0x20 */
+    D, D, D, D, D, D, D, D, D, D, 0, 0, 0, 0, 0, 0, /* 0x30 */
+    0, U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, /* 0x40 */
+    U, U, U, U, U, U, U, U, U, U, U, 0, 0, 0, 0, 0, /* 0x50 */
+    0, L, L, L, L, L, L, L, L, L, L, L, L, L, L, L, /* 0x60 */
+    L, L, L, L, L, L, L, L, L, L, L, 0, 0, 0, 0, 0, /* 0x70 */
+};
+#undef S
+#undef D
+#undef L
+#undef U
+
+
+static bool ww_is_space(char c) {
+    return (ww_char_class[(unsigned char)c] & WW_CHAR_SPACE) != 0;
+}
+
+static bool ww_is_digit(char c) {
+    return (ww_char_class[(unsigned char)c] & WW_CHAR_DIGIT) != 0;
+}
+
+static bool ww_is_alpha(char c) {
+    return (ww_char_class[(unsigned char)c] & WW_CHAR_ALPHA) != 0;
+}
+
+static char ww_to_lower(char c) {
+    return (ww_char_class[(unsigned char)c] & WW_CHAR_UPPER) ? (char)(c + ('a' - 'A')) : c;
+}
+
+static char ww_to_upper(char c) {
+    return (ww_char_class[(unsigned char)c] & WW_CHAR_LOWER) ? (char)(c - ('a' - 'A')) : c;
+}
+
+static const char *ww_skip_space(const char *p) {
+    while (ww_is_space(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static bool ww_scan_count(const char **p, int64_t *out) {
+    const char *s = *p;
+    int64_t value = 0;
+    if (!ww_is_digit(*s)) {
+        return false;
+    }
+    while (ww_is_digit(*s)) {
+        if (value > (INT64_MAX - 9) / 10) {
+            return false;
+        }
+        value = value * 10 + (*s - '0');
+        s++;
+    }
+    *p = s;
+    *out = value;
+    return true;
+}
+
+/* A decimal literal split into its integer part and the raw fractional
+ * digits, so it can be scaled exactly without going through a double. */
+typedef struct {
+    int64_t whole;
+    const char *frac;
+    size_t frac_len;
+} ww_decimal;
+
+static bool ww_scan_decimal(const char **p, bool allow_comma, ww_decimal *out) {
+    const char *s = *p;
+    int64_t whole = 0;
+    bool digits = false;
+    while (ww_is_digit(*s)) {
+        if (whole > (INT64_MAX - 9) / 10) {
+            return false;
+        }
+        whole = whole * 10 + (*s - '0');
+        digits = true;
+        s++;
+    }
+    out->frac = s;
+    out->frac_len = 0;
+    if (*s == '.' || (allow_comma && *s == ',')) {
+        const char *frac = s + 1;
+        size_t frac_len = 0;
+        while (ww_is_digit(frac[frac_len])) {
+            frac_len++;
+        }
+        if (frac_len > 0) {
+            out->frac = frac;
+            out->frac_len = frac_len;
+            digits = true;
+            s = frac + frac_len;
+        } else if (digits) {
+            s++;
+        }
+    }
+    if (!digits) {
+        return false;
+    }
+    out->whole = whole;
+    *p = s;
+    return true;
+}
+
+/* Converts a scanned decimal to a double by folding as many fraction digits
+ * as fit in an int64 into one mantissa, rounding on the next digit, and
+ * dividing once by an exact power of ten. When the mantissa holds every
+ * digit and fits in 2^53 the result is correctly rounded and matches strtod
+ * bit for bit; otherwise it can land one ulp away. */
+static double ww_decimal_to_double(const ww_decimal *value) {
+    static const double powers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    int64_t mantissa = value->whole;
+    size_t digits = 0;
+    while (digits < value->frac_len && digits < 22 && mantissa <= (INT64_MAX - 9) / 10) {
+        mantissa = mantissa * 10 + (value->frac[digits] - '0');
+        digits++;
+    }
+    if (digits < value->frac_len && value->frac[digits] >= '5') {
+        mantissa++;
+    }
+    return (double)mantissa / powers[digits];
+}
+
+static bool ww_buf_reserve(ww_buf *buf, size_t extra) {
+    if (buf->len + extra < buf->cap) {
+        return true;
+    }
+    if (!buf->realloc_fn) {
+        return false;
+    }
+    size_t needed = buf->len + extra + 1;
+    size_t new_cap = buf->cap < 32 ? 32 : buf->cap * 2;
+    if (new_cap < needed) {
+        new_cap = needed;
+    }
+    char *grown = (char *)buf->realloc_fn(buf->ptr, new_cap);
+    if (!grown) {
+        return false;
+    }
+    buf->ptr = grown;
+    buf->cap = new_cap;
+    return true;
+}
+
+static bool ww_buf_append_raw(ww_buf *buf, const char *s, size_t len) {
+    if (!ww_buf_reserve(buf, len)) {
+        return false;
+    }
+    memcpy(buf->ptr + buf->len, s, len);
+    buf->len += len;
+    buf->ptr[buf->len] = '\0';
+    return true;
+}
+
+static const char *ww_escape_byte(ww_escape_mode mode, unsigned char c, char scratch[8]) {
+    if (mode == WW_ESCAPE_JSON) {
+        switch (c) {
+        case '"':
+            return "\\\"";
+        case '\\':
+            return "\\\\";
+        case '\n':
+            return "\\n";
+        case '\r':
+            return "\\r";
+        case '\t':
+            return "\\t";
+        default:
+            if (c < 0x20) {
+                snprintf(scratch, 8, "\\u%04x", c);
+                return scratch;
+            }
+            return NULL;
+        }
+    }
+    if (mode == WW_ESCAPE_HTML) {
+        switch (c) {
+        case '&':
+            return "&amp;";
+        case '<':
+            return "&lt;";
+        case '>':
+            return "&gt;";
+        case '"':
+            return "&quot;";
+        case '\'':
+            return "&#39;";
+        default:
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+/* Appends `s` escaped for `mode`. Multi-byte UTF-8 (the en dash in date
+ * ranges) is valid in both JSON strings and HTML text and is copied as-is. */
+static bool ww_buf_append(ww_buf *buf, ww_escape_mode mode, const char *s, size_t len) {
+    if (mode == WW_ESCAPE_NONE) {
+        return ww_buf_append_raw(buf, s, len);
+    }
+    size_t run = 0;
+    for (size_t i = 0; i < len; i++) {
+        char scratch[8];
+        const char *escaped = ww_escape_byte(mode, (unsigned char)s[i], scratch);
+        if (!escaped) {
+            continue;
+        }
+        if (!ww_buf_append_raw(buf, s + run, i - run) ||
+            !ww_buf_append_raw(buf, escaped, strlen(escaped))) {
+            return false;
+        }
+        run = i + 1;
     }
-    memcpy(out, s, len + 1);
-    return out;
+    return ww_buf_append_raw(buf, s + run, len - run);
+}
+
+static bool ww_buf_append_str(ww_buf *buf, ww_escape_mode mode, const char *s) {
+    return ww_buf_append(buf, mode, s, strlen(s));
 }
 
-static char *ww_strdup_printf(const char *fmt, ...) {
+static bool ww_buf_appendf(ww_buf *buf, ww_escape_mode mode, const char *fmt, ...) {
+    char tmp[256];
     va_list ap;
     va_start(ap, fmt);
-    int needed = vsnprintf(NULL, 0, fmt, ap);
+    int written = vsnprintf(tmp, sizeof(tmp), fmt, ap);
     va_end(ap);
-    if (needed < 0) {
-        return NULL;
+    if (written < 0 || (size_t)written >= sizeof(tmp)) {
+        return false;
     }
-    char *buf = (char *)malloc((size_t)needed + 1);
-    if (!buf) {
+    return ww_buf_append(buf, mode, tmp, (size_t)written);
+}
+
+/* Rolls a failed append back to `mark` so callers never see partial output. */
+static bool ww_buf_finish(ww_buf *buf, size_t mark, bool ok) {
+    if (!ok && buf->len >= mark) {
+        buf->len = mark;
+        if (buf->cap > 0) {
+            buf->ptr[mark] = '\0';
+        }
+    }
+    return ok;
+}
+
+static char *ww_buf_detach(ww_buf *buf, bool ok) {
+    if (!ok) {
+        free(buf->ptr);
         return NULL;
     }
-    va_start(ap, fmt);
-    vsnprintf(buf, (size_t)needed + 1, fmt, ap);
-    va_end(ap);
-    return buf;
+    return buf->ptr;
+}
+
+static ww_buf ww_buf_heap(void) {
+    return ww_buf_init(NULL, 0, realloc);
 }
 
 static int64_t ww_days_from_civil(int y, unsigned m, unsigned d) {
@@ -85,10 +368,39 @@ static int ww_day_of_week_from_days(int64_t days_since_epoch) {
     return weekday;
 }
 
+/* A normalized instant with its day number and, once requested, its civil
+ * date, so several formatters can share one decomposition. */
+typedef struct {
+    double seconds;
+    int64_t days;
+    int year;
+    unsigned month;
+    unsigned day;
+    bool has_civil;
+} ww_moment;
+
+static ww_moment ww_moment_make(double seconds) {
+    ww_moment moment;
+    moment.seconds = seconds;
+    moment.days = ww_days_from_unix_seconds(seconds);
+    moment.year = 0;
+    moment.month = 0;
+    moment.day = 0;
+    moment.has_civil = false;
+    return moment;
+}
+
+static void ww_moment_civil(ww_moment *moment) {
+    if (!moment->has_civil) {
+        ww_civil_from_days(moment->days, &moment->year, &moment->month, &moment->day);
+        moment->has_civil = true;
+    }
+}
+
 static bool ww_parse_int_fixed(const char *s, size_t len, int *out) {
     int value = 0;
     for (size_t i = 0; i < len; i++) {
-        if (!isdigit((unsigned char)s[i])) {
+        if (!ww_is_digit(s[i])) {
             return false;
         }
         value = value * 10 + (s[i] - '0');
@@ -97,15 +409,16 @@ static bool ww_parse_int_fixed(const char *s, size_t len, int *out) {
     return true;
 }
 
+/* iso__parse(trimmed length, whole seconds) fires on success only. */
 static bool ww_parse_iso8601(const char *input, double *out_seconds) {
     if (!input) {
         return false;
     }
-    while (isspace((unsigned char)*input)) {
+    while (ww_is_space(*input)) {
         input++;
     }
     size_t len = strlen(input);
-    while (len > 0 && isspace((unsigned char)input[len - 1])) {
+    while (len > 0 && ww_is_space(input[len - 1])) {
         len--;
     }
     if (len < 10) {
@@ -139,6 +452,7 @@ static bool ww_parse_iso8601(const char *input, double *out_seconds) {
     int64_t days = ww_days_from_civil(year, (unsigned)month, (unsigned)day);
     double total = (double)days * WW_SECONDS_PER_DAY + (double)hour * WW_SECONDS_PER_HOUR +
                    (double)minute * WW_SECONDS_PER_MINUTE + (double)second;
+    WW_PROBE2(iso__parse, (int)len, (long long)total);
     *out_seconds = total;
     return true;
 }
@@ -174,333 +488,892 @@ static bool ww_normalize_timestamp(ww_timestamp ts, double *out_seconds) {
     }
 }
 
-static int64_t ww_round_half_up(double value) {
-    double floor_value = floor(value);
-    double frac = value - floor_value;
-    if (frac > 0.5 || fabs(frac - 0.5) < 1e-12) {
-        return (int64_t)floor_value + 1;
+/* Shared "now" for implicit references. Kept on its own cache line so readers
+ * on the render path never share it with unrelated writes. */
+typedef struct {
+    uint64_t now_bits;
+    uint32_t mode;
+    unsigned char pad[WW_CACHE_LINE_SIZE - sizeof(uint64_t) - sizeof(uint32_t)];
+} ww_clock_state;
+
+static ww_clock_state ww_clock WW_CACHE_ALIGNED = {0, WW_CLOCK_OFF, {0}};
+
+static double ww_clock_read(void) {
+#if defined(WW_CLOCK_SOURCE)
+    struct timespec now;
+    if (clock_gettime(WW_CLOCK_SOURCE, &now) == 0) {
+        return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
     }
-    return (int64_t)floor_value;
+#endif
+    return (double)time(NULL);
 }
 
-static const char *ww_plural(const char *singular, const char *plural, int64_t count) {
-    return (count == 1) ? singular : plural;
+static void ww_clock_store(double unix_seconds) {
+    uint64_t bits = 0;
+    memcpy(&bits, &unix_seconds, sizeof(bits));
+    WW_ATOMIC_STORE(&ww_clock.now_bits, bits);
 }
 
-ww_duration_options ww_duration_options_default(void) {
-    ww_duration_options options;
-    options.compact = 0;
-    options.max_units = 2;
-    return options;
+static double ww_clock_update(void) {
+    double now = ww_clock_read();
+    ww_clock_store(now);
+    return now;
 }
 
-char *timeago(ww_timestamp timestamp, ww_timestamp reference) {
-    double ts_seconds = 0.0;
-    if (!ww_normalize_timestamp(timestamp, &ts_seconds)) {
-        return NULL;
+static double ww_clock_current(void) {
+    if (WW_ATOMIC_LOAD(&ww_clock.mode) != WW_CLOCK_CACHED) {
+        return ww_clock_read();
+    }
+    double now = 0.0;
+    uint64_t bits = WW_ATOMIC_LOAD(&ww_clock.now_bits);
+    memcpy(&now, &bits, sizeof(now));
+    return now;
+}
+
+/* The public clock functions fire call probes; the library itself uses the
+ * helpers above so traces only count calls the application made. */
+void ww_clock_set_mode(ww_clock_mode mode) {
+    WW_TRACE_ENTRY(WW_TRACE_NO_KIND);
+    if (mode == WW_CLOCK_CACHED) {
+        ww_clock_update();
     }
-    double ref_seconds = ts_seconds;
+    WW_ATOMIC_STORE(&ww_clock.mode, (uint32_t)mode);
+    WW_TRACE_RETURN(0);
+}
+
+void ww_clock_set(double unix_seconds) {
+    WW_TRACE_ENTRY(WW_TS_UNIX);
+    ww_clock_store(unix_seconds);
+    WW_TRACE_RETURN(0);
+}
+
+double ww_clock_refresh(void) {
+    WW_TRACE_ENTRY(WW_TRACE_NO_KIND);
+    double now = ww_clock_update();
+    WW_TRACE_RETURN(0);
+    return now;
+}
+
+double ww_clock_now(void) {
+    WW_TRACE_ENTRY(WW_TRACE_NO_KIND);
+    double now = ww_clock_current();
+    WW_TRACE_RETURN(0);
+    return now;
+}
+
+/* Resolves the reference for relative formatters. Unset references use the
+ * library clock when enabled and otherwise fall back to `fallback`. */
+static bool ww_normalize_reference(ww_timestamp reference, double fallback, double *out_seconds) {
     if (reference.kind != WW_TS_NONE) {
-        if (!ww_normalize_timestamp(reference, &ref_seconds)) {
-            return NULL;
-        }
+        return ww_normalize_timestamp(reference, out_seconds);
     }
-    double diff = ref_seconds - ts_seconds;
-    double abs_diff = fabs(diff);
-    if (abs_diff < 45.0) {
-        return ww_strdup("just now");
+    if (WW_ATOMIC_LOAD(&ww_clock.mode) == WW_CLOCK_OFF) {
+        *out_seconds = fallback;
+        return true;
     }
+    *out_seconds = ww_clock_current();
+    return true;
+}
 
-    const char *unit = NULL;
-    int64_t n = 0;
+/* Call capture. Build with -DWW_ENABLE_CAPTURE, then ww_capture_start()
+ * records every scalar formatting and parsing call into a per-thread ring.
+ * Producers never block or take locks: a full ring drops the record and
+ * counts it. ww_capture_flush() drains the rings into the trace file; call
+ * it from one thread, like ww_clock_refresh(). */
+#if defined(WW_ENABLE_CAPTURE)
+#if !defined(__GNUC__) && !defined(__clang__)
+#error "WW_ENABLE_CAPTURE needs GCC or Clang for __thread and __atomic builtins"
+#endif
 
-    if (abs_diff < 90.0) {
-        unit = "minute";
-        n = 1;
-    } else if (abs_diff < 45.0 * WW_SECONDS_PER_MINUTE) {
-        unit = "minute";
-        n = ww_round_half_up(abs_diff / WW_SECONDS_PER_MINUTE);
-    } else if (abs_diff < 90.0 * WW_SECONDS_PER_MINUTE) {
-        unit = "hour";
-        n = 1;
-    } else if (abs_diff < 22.0 * WW_SECONDS_PER_HOUR) {
-        unit = "hour";
-        n = ww_round_half_up(abs_diff / WW_SECONDS_PER_HOUR);
-    } else if (abs_diff < 36.0 * WW_SECONDS_PER_HOUR) {
-        unit = "day";
-        n = 1;
-    } else if (abs_diff < 26.0 * WW_SECONDS_PER_DAY) {
-        unit = "day";
-        n = ww_round_half_up(abs_diff / WW_SECONDS_PER_DAY);
-    } else if (abs_diff < 46.0 * WW_SECONDS_PER_DAY) {
-        unit = "month";
-        n = 1;
-    } else if (abs_diff < 320.0 * WW_SECONDS_PER_DAY) {
-        double month_seconds = WW_SECONDS_PER_YEAR / 12.0;
-        unit = "month";
-        n = ww_round_half_up(abs_diff / month_seconds);
-    } else if (abs_diff < 548.0 * WW_SECONDS_PER_DAY) {
-        unit = "year";
-        n = 1;
-    } else {
-        unit = "year";
-        n = ww_round_half_up(abs_diff / WW_SECONDS_PER_YEAR);
-    }
+#define WW_CAPTURE(call) do { if (__atomic_load_n(&ww_capture_active, __ATOMIC_RELAXED)) { call; } } while (0)
 
-    const char *unit_label = ww_plural(unit, unit, n);
-    if (n != 1) {
-        if (strcmp(unit, "day") == 0) {
-            unit_label = "days";
-        } else if (strcmp(unit, "hour") == 0) {
-            unit_label = "hours";
-        } else if (strcmp(unit, "minute") == 0) {
-            unit_label = "minutes";
-        } else if (strcmp(unit, "month") == 0) {
-            unit_label = "months";
-        } else if (strcmp(unit, "year") == 0) {
-            unit_label = "years";
-        }
+#define WW_CAPTURE_RING_SIZE 65536u
+#define WW_CAPTURE_MAX_RECORD 1024u
+#define WW_CAPTURE_NULL_STRING 0xffffu
+
+/* Single-producer ring owned by one thread. `head` and `tail` sit on their
+ * own cache lines so the producer and the draining thread do not share one. */
+typedef struct ww_capture_ring {
+    uint64_t head WW_CACHE_ALIGNED;
+    uint64_t tail WW_CACHE_ALIGNED;
+    struct ww_capture_ring *next;
+    unsigned char data[WW_CAPTURE_RING_SIZE];
+} ww_capture_ring;
+
+typedef struct {
+    unsigned char data[WW_CAPTURE_MAX_RECORD];
+    size_t len;
+    bool overflow;
+} ww_capture_record;
+
+static uint32_t ww_capture_active;
+static uint64_t ww_capture_lost;
+static ww_capture_ring *ww_capture_rings;
+static FILE *ww_capture_file;
+static __thread ww_capture_ring *ww_capture_local;
+
+/* Rings are registered once per thread and kept for the life of the process,
+ * so the drain never races with a thread freeing its ring. */
+static ww_capture_ring *ww_capture_ring_get(void) {
+    ww_capture_ring *ring = ww_capture_local;
+    if (ring) {
+        return ring;
+    }
+    void *memory = NULL;
+    if (posix_memalign(&memory, WW_CACHE_LINE_SIZE, sizeof(ww_capture_ring)) != 0) {
+        return NULL;
+    }
+    ring = (ww_capture_ring *)memory;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->next = __atomic_load_n(&ww_capture_rings, __ATOMIC_ACQUIRE);
+    while (!__atomic_compare_exchange_n(&ww_capture_rings, &ring->next, ring, true, __ATOMIC_RELEASE,
+                                        __ATOMIC_ACQUIRE)) {
     }
+    ww_capture_local = ring;
+    return ring;
+}
 
-    if (diff < 0) {
-        return ww_strdup_printf("in %lld %s", (long long)n, unit_label);
+static void ww_capture_put(ww_capture_record *record, const void *data, size_t len) {
+    if (record->overflow || WW_CAPTURE_MAX_RECORD - record->len < len) {
+        record->overflow = true;
+        return;
     }
-    return ww_strdup_printf("%lld %s ago", (long long)n, unit_label);
+    memcpy(record->data + record->len, data, len);
+    record->len += len;
 }
 
-char *duration(double seconds, const ww_duration_options *options) {
-    if (seconds < 0.0 || isnan(seconds) || isinf(seconds)) {
-        return NULL;
+static void ww_capture_put_u8(ww_capture_record *record, unsigned value) {
+    unsigned char byte = (unsigned char)value;
+    ww_capture_put(record, &byte, 1);
+}
+
+static void ww_capture_put_string(ww_capture_record *record, const char *s) {
+    size_t len = s ? strlen(s) : 0;
+    uint16_t prefix = s ? (uint16_t)len : (uint16_t)WW_CAPTURE_NULL_STRING;
+    if (len >= WW_CAPTURE_NULL_STRING) {
+        record->overflow = true;
+        return;
     }
-    ww_duration_options opts = ww_duration_options_default();
-    if (options) {
-        opts = *options;
-        if (opts.max_units <= 0) {
-            opts.max_units = 2;
-        }
-    }
-
-    const struct {
-        const char *name_singular;
-        const char *name_plural;
-        const char *compact;
-        double unit_seconds;
-    } units[] = {
-        {"year", "years", "y", WW_SECONDS_PER_YEAR},
-        {"month", "months", "mo", WW_SECONDS_PER_MONTH},
-        {"day", "days", "d", WW_SECONDS_PER_DAY},
-        {"hour", "hours", "h", WW_SECONDS_PER_HOUR},
-        {"minute", "minutes", "m", WW_SECONDS_PER_MINUTE},
-        {"second", "seconds", "s", 1.0},
-    };
-
-    int64_t counts[sizeof(units) / sizeof(units[0])];
-    size_t count_len = sizeof(units) / sizeof(units[0]);
-    double remaining = seconds;
-    for (size_t i = 0; i < count_len; i++) {
-        counts[i] = (int64_t)floor(remaining / units[i].unit_seconds);
-        remaining -= (double)counts[i] * units[i].unit_seconds;
-        if (remaining < 0.0) {
-            remaining = 0.0;
-        }
-    }
-
-    size_t start_index = count_len;
-    for (size_t i = 0; i < count_len; i++) {
-        if (counts[i] > 0) {
-            start_index = i;
-            break;
+    ww_capture_put(record, &prefix, sizeof(prefix));
+    ww_capture_put(record, s, len);
+}
+
+static void ww_capture_put_timestamp(ww_capture_record *record, ww_timestamp ts) {
+    ww_capture_put_u8(record, (unsigned)ts.kind);
+    switch (ts.kind) {
+    case WW_TS_UNIX:
+        ww_capture_put(record, &ts.unix_seconds, sizeof(ts.unix_seconds));
+        break;
+    case WW_TS_ISO:
+        ww_capture_put_string(record, ts.iso);
+        break;
+    case WW_TS_TM:
+        ww_capture_put_u8(record, ts.tm != NULL);
+        if (ts.tm) {
+            int32_t fields[6] = {ts.tm->tm_year, ts.tm->tm_mon, ts.tm->tm_mday,
+                                 ts.tm->tm_hour, ts.tm->tm_min, ts.tm->tm_sec};
+            ww_capture_put(record, fields, sizeof(fields));
         }
+        break;
+    default:
+        break;
     }
-    if (start_index == count_len) {
-        return ww_strdup(opts.compact ? "0s" : "0 seconds");
-    }
+}
+
+static void ww_capture_begin(ww_capture_record *record, ww_capture_op op, ww_escape_mode mode) {
+    record->len = sizeof(uint16_t);
+    record->overflow = false;
+    ww_capture_put_u8(record, (unsigned)op);
+    ww_capture_put_u8(record, (unsigned)mode);
+}
 
-    size_t end_index = start_index + (size_t)opts.max_units - 1;
-    if (end_index >= count_len) {
-        end_index = count_len - 1;
+static void ww_capture_commit(ww_capture_record *record) {
+    ww_capture_ring *ring = record->overflow ? NULL : ww_capture_ring_get();
+    uint64_t head = ring ? ring->head : 0;
+    if (!ring || WW_CAPTURE_RING_SIZE - (head - WW_ATOMIC_LOAD(&ring->tail)) < record->len) {
+        __atomic_fetch_add(&ww_capture_lost, 1, __ATOMIC_RELAXED);
+        return;
     }
+    uint16_t size = (uint16_t)record->len;
+    memcpy(record->data, &size, sizeof(size));
+    size_t at = (size_t)(head & (WW_CAPTURE_RING_SIZE - 1));
+    size_t first = WW_CAPTURE_RING_SIZE - at < record->len ? WW_CAPTURE_RING_SIZE - at : record->len;
+    memcpy(ring->data + at, record->data, first);
+    memcpy(ring->data, record->data + first, record->len - first);
+    WW_ATOMIC_STORE(&ring->head, head + record->len);
+}
 
-    char buffer[256];
-    size_t pos = 0;
-    size_t emitted = 0;
-    for (size_t idx = start_index; idx <= end_index; idx++) {
-        if (counts[idx] == 0) {
-            continue;
-        }
-        if (emitted > 0) {
-            const char *sep = opts.compact ? " " : ", ";
-            size_t sep_len = strlen(sep);
-            if (pos + sep_len < sizeof(buffer)) {
-                memcpy(buffer + pos, sep, sep_len);
-                pos += sep_len;
-            }
-        }
-        if (opts.compact) {
-            int written = snprintf(buffer + pos, sizeof(buffer) - pos, "%lld%s",
-                                   (long long)counts[idx], units[idx].compact);
-            if (written < 0) {
-                break;
-            }
-            pos += (size_t)written;
-        } else {
-            const char *label = ww_plural(units[idx].name_singular, units[idx].name_plural, counts[idx]);
-            int written = snprintf(buffer + pos, sizeof(buffer) - pos, "%lld %s",
-                                   (long long)counts[idx], label);
-            if (written < 0) {
-                break;
-            }
-            pos += (size_t)written;
-        }
-        emitted++;
-        if (pos >= sizeof(buffer)) {
-            pos = sizeof(buffer) - 1;
-            break;
-        }
+static void ww_capture_pair(ww_capture_op op, ww_escape_mode mode, ww_timestamp first, ww_timestamp second) {
+    ww_capture_record record;
+    ww_capture_begin(&record, op, mode);
+    ww_capture_put_timestamp(&record, first);
+    ww_capture_put_timestamp(&record, second);
+    ww_capture_commit(&record);
+}
+
+static void ww_capture_duration(ww_escape_mode mode, double seconds, const ww_duration_options *options) {
+    ww_capture_record record;
+    ww_capture_begin(&record, WW_CAPTURE_DURATION, mode);
+    ww_capture_put(&record, &seconds, sizeof(seconds));
+    ww_capture_put_u8(&record, options != NULL);
+    if (options) {
+        int32_t fields[2] = {options->compact, options->max_units};
+        ww_capture_put(&record, fields, sizeof(fields));
     }
-    buffer[pos] = '\0';
-    return ww_strdup(buffer);
+    ww_capture_commit(&record);
 }
 
-static const struct {
-    const char *name;
-    double multiplier;
-} ww_unit_map[] = {
-    {"s", 1.0},
-    {"sec", 1.0},
-    {"secs", 1.0},
-    {"second", 1.0},
-    {"seconds", 1.0},
-    {"m", 60.0},
-    {"min", 60.0},
-    {"mins", 60.0},
-    {"minute", 60.0},
-    {"minutes", 60.0},
-    {"h", 3600.0},
-    {"hr", 3600.0},
-    {"hrs", 3600.0},
-    {"hour", 3600.0},
-    {"hours", 3600.0},
-    {"d", 86400.0},
-    {"day", 86400.0},
-    {"days", 86400.0},
-    {"w", 604800.0},
-    {"wk", 604800.0},
-    {"wks", 604800.0},
-    {"week", 604800.0},
-    {"weeks", 604800.0},
-};
+static void ww_capture_parse(ww_capture_op op, const char *input, const ww_timestamp *reference) {
+    ww_capture_record record;
+    ww_capture_begin(&record, op, WW_ESCAPE_NONE);
+    ww_capture_put_string(&record, input);
+    if (reference) {
+        ww_capture_put_timestamp(&record, *reference);
+    }
+    ww_capture_commit(&record);
+}
 
-static bool ww_is_word(const char *s, const char *word) {
-    size_t len = strlen(word);
-    for (size_t i = 0; i < len; i++) {
-        if (tolower((unsigned char)s[i]) != word[i]) {
-            return false;
+/* Writes everything published so far; a NULL `file` discards it. */
+static bool ww_capture_drain(FILE *file) {
+    bool ok = true;
+    for (ww_capture_ring *ring = WW_ATOMIC_LOAD(&ww_capture_rings); ring; ring = ring->next) {
+        uint64_t tail = ring->tail;
+        uint64_t head = WW_ATOMIC_LOAD(&ring->head);
+        while (tail != head) {
+            size_t at = (size_t)(tail & (WW_CAPTURE_RING_SIZE - 1));
+            size_t len = (size_t)(head - tail) < WW_CAPTURE_RING_SIZE - at ? (size_t)(head - tail)
+                                                                          : WW_CAPTURE_RING_SIZE - at;
+            if (file && fwrite(ring->data + at, 1, len, file) != len) {
+                ok = false;
+            }
+            tail += len;
         }
+        WW_ATOMIC_STORE(&ring->tail, tail);
     }
-    return !isalpha((unsigned char)s[len]);
+    return ok;
 }
 
-static bool ww_parse_colon_duration(const char *input, double *out_seconds) {
-    const char *p = input;
-    while (isspace((unsigned char)*p)) {
-        p++;
-    }
-    if (!strchr(p, ':')) {
+static bool ww_capture_open(const char *path) {
+    if (!path || ww_capture_file) {
         return false;
     }
-    char *copy = ww_strdup(p);
-    if (!copy) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
         return false;
     }
-    size_t len = strlen(copy);
-    while (len > 0 && isspace((unsigned char)copy[len - 1])) {
-        copy[len - 1] = '\0';
-        len--;
+    uint32_t byte_order = WW_CAPTURE_BYTE_ORDER;
+    if (fwrite(WW_CAPTURE_MAGIC, 1, 8, file) != 8 || fwrite(&byte_order, sizeof(byte_order), 1, file) != 1) {
+        fclose(file);
+        return false;
     }
+    ww_capture_drain(NULL);
+    __atomic_store_n(&ww_capture_lost, 0, __ATOMIC_RELAXED);
+    ww_capture_file = file;
+    WW_ATOMIC_STORE(&ww_capture_active, 1);
+    return true;
+}
 
-    int parts[3] = {0, 0, 0};
-    int count = 0;
-    char *save = NULL;
-    char *token = strtok_r(copy, ":", &save);
-    while (token && count < 3) {
-        char *endptr = NULL;
-        long value = strtol(token, &endptr, 10);
-        if (endptr == token || value < 0) {
-            free(copy);
-            return false;
-        }
-        parts[count++] = (int)value;
-        token = strtok_r(NULL, ":", &save);
-    }
-    if (token != NULL || (count != 2 && count != 3)) {
-        free(copy);
+static bool ww_capture_sync(void) {
+    if (!ww_capture_file) {
         return false;
     }
-    double total = 0.0;
-    if (count == 2) {
-        total = (double)parts[0] * WW_SECONDS_PER_HOUR + (double)parts[1] * WW_SECONDS_PER_MINUTE;
-    } else {
-        total = (double)parts[0] * WW_SECONDS_PER_HOUR + (double)parts[1] * WW_SECONDS_PER_MINUTE +
-                (double)parts[2];
-    }
-    free(copy);
-    *out_seconds = total;
-    return true;
+    bool ok = ww_capture_drain(ww_capture_file);
+    return fflush(ww_capture_file) == 0 && ok;
 }
 
-bool parse_duration(const char *input, double *out_seconds) {
-    if (!input || !out_seconds) {
+static bool ww_capture_close(void) {
+    if (!ww_capture_file) {
         return false;
     }
-    if (ww_parse_colon_duration(input, out_seconds)) {
-        return true;
+    WW_ATOMIC_STORE(&ww_capture_active, 0);
+    bool ok = ww_capture_drain(ww_capture_file);
+    ok = fclose(ww_capture_file) == 0 && ok;
+    ww_capture_file = NULL;
+    return ok;
+}
+
+static uint64_t ww_capture_lost_count(void) {
+    return __atomic_load_n(&ww_capture_lost, __ATOMIC_RELAXED);
+}
+#else
+#define WW_CAPTURE(call) ((void)0)
+
+static bool ww_capture_open(const char *path) {
+    (void)path;
+    return false;
+}
+
+static bool ww_capture_sync(void) {
+    return false;
+}
+
+static bool ww_capture_close(void) {
+    return false;
+}
+
+static uint64_t ww_capture_lost_count(void) {
+    return 0;
+}
+#endif
+
+bool ww_capture_start(const char *path) {
+    WW_TRACE_ENTRY(WW_TRACE_NO_KIND);
+    bool ok = ww_capture_open(path);
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, 0));
+    return ok;
+}
+
+bool ww_capture_flush(void) {
+    WW_TRACE_ENTRY(WW_TRACE_NO_KIND);
+    bool ok = ww_capture_sync();
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, 0));
+    return ok;
+}
+
+bool ww_capture_stop(void) {
+    WW_TRACE_ENTRY(WW_TRACE_NO_KIND);
+    bool ok = ww_capture_close();
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, 0));
+    return ok;
+}
+
+uint64_t ww_capture_dropped(void) {
+    WW_TRACE_ENTRY(WW_TRACE_NO_KIND);
+    uint64_t dropped = ww_capture_lost_count();
+    WW_TRACE_RETURN(dropped);
+    return dropped;
+}
+
+static ww_packed_ts ww_pack(ww_timestamp ts) {
+    double seconds = 0.0;
+    if (!ww_normalize_timestamp(ts, &seconds) || isnan(seconds)) {
+        return NAN;
     }
+    return seconds;
+}
 
-    const char *p = input;
-    while (isspace((unsigned char)*p)) {
-        p++;
+ww_packed_ts ww_timestamp_pack(ww_timestamp ts) {
+    WW_TRACE_ENTRY(ts.kind);
+    ww_packed_ts packed = ww_pack(ts);
+    WW_TRACE_RETURN(WW_TRACE_LEN(ww_packed_is_set(packed), 0));
+    return packed;
+}
+
+size_t ww_timestamp_pack_array(const ww_timestamp *in, size_t n, ww_packed_ts *out) {
+    WW_TRACE_ENTRY(WW_TRACE_NO_KIND);
+    size_t valid = 0;
+    if (!in || !out) {
+        WW_TRACE_RETURN(-1);
+        return 0;
     }
-    if (*p == '\0') {
-        return false;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = ww_pack(in[i]);
+        valid += ww_packed_is_set(out[i]);
     }
+    WW_TRACE_RETURN(0);
+    return valid;
+}
 
-    double total = 0.0;
-    bool found = false;
+/* Fractions this close below .5 still round up. */
+#define WW_ROUND_HALF_TOLERANCE 1e-12
 
-    while (*p) {
-        while (*p && (isspace((unsigned char)*p) || *p == ',')) {
-            p++;
-        }
-        if (*p == '\0') {
-            break;
-        }
-        if (isalpha((unsigned char)*p)) {
-            if (ww_is_word(p, "and")) {
-                p += 3;
-                continue;
-            }
-            return false;
+static int64_t ww_round_half_up(double value) {
+    double floor_value = floor(value);
+    double frac = value - floor_value;
+    if (frac > 0.5 || fabs(frac - 0.5) < WW_ROUND_HALF_TOLERANCE) {
+        return (int64_t)floor_value + 1;
+    }
+    return (int64_t)floor_value;
+}
+
+static const char *ww_plural(const char *singular, const char *plural, int64_t count) {
+    return (count == 1) ? singular : plural;
+}
+
+ww_duration_options ww_duration_options_default(void) {
+    WW_TRACE_ENTRY(WW_TRACE_NO_KIND);
+    ww_duration_options options;
+    options.compact = 0;
+    options.max_units = 2;
+    WW_TRACE_RETURN(0);
+    return options;
+}
+
+typedef struct {
+    double upper;
+    double divisor;
+    const char *singular;
+    const char *plural;
+} ww_timeago_bucket;
+
+/* Buckets are evaluated in order; each covers [previous upper, upper). A zero
+ * divisor means the bucket always renders a count of 1. */
+static const ww_timeago_bucket ww_timeago_buckets[] = {
+    {45.0, 0.0, NULL, NULL},
+    {90.0, 0.0, "minute", "minutes"},
+    {45.0 * WW_SECONDS_PER_MINUTE, WW_SECONDS_PER_MINUTE, "minute", "minutes"},
+    {90.0 * WW_SECONDS_PER_MINUTE, 0.0, "hour", "hours"},
+    {22.0 * WW_SECONDS_PER_HOUR, WW_SECONDS_PER_HOUR, "hour", "hours"},
+    {36.0 * WW_SECONDS_PER_HOUR, 0.0, "day", "days"},
+    {26.0 * WW_SECONDS_PER_DAY, WW_SECONDS_PER_DAY, "day", "days"},
+    {46.0 * WW_SECONDS_PER_DAY, 0.0, "month", "months"},
+    {320.0 * WW_SECONDS_PER_DAY, WW_SECONDS_PER_YEAR / 12.0, "month", "months"},
+    {548.0 * WW_SECONDS_PER_DAY, 0.0, "year", "years"},
+    {HUGE_VAL, WW_SECONDS_PER_YEAR, "year", "years"},
+};
+
+#define WW_TIMEAGO_BUCKET_COUNT (sizeof(ww_timeago_buckets) / sizeof(ww_timeago_buckets[0]))
+
+static size_t ww_timeago_bucket_index(double abs_diff) {
+    size_t i = 0;
+    while (i + 1 < WW_TIMEAGO_BUCKET_COUNT && abs_diff >= ww_timeago_buckets[i].upper) {
+        i++;
+    }
+    return i;
+}
+
+/* Picks the bucket and count timeago renders for `abs_diff`. parse_timeago
+ * checks its ranges against this, so both sides round the same way. */
+static size_t ww_timeago_classify(double abs_diff, int64_t *out_n) {
+    size_t bucket_index = ww_timeago_bucket_index(abs_diff);
+    const ww_timeago_bucket *bucket = &ww_timeago_buckets[bucket_index];
+    *out_n = 1;
+    if (bucket->divisor > 0.0) {
+        *out_n = ww_round_half_up(abs_diff / bucket->divisor);
+    }
+    return bucket_index;
+}
+
+static bool ww_timeago_write_seconds(ww_buf *buf, ww_escape_mode mode, double ts_seconds, double ref_seconds) {
+    double diff = ref_seconds - ts_seconds;
+    double abs_diff = fabs(diff);
+    int64_t n = 1;
+    size_t bucket_index = ww_timeago_classify(abs_diff, &n);
+    const ww_timeago_bucket *bucket = &ww_timeago_buckets[bucket_index];
+    WW_PROBE2(timeago__bucket, (int)bucket_index, (long long)abs_diff);
+    if (!bucket->singular) {
+        return ww_buf_append_str(buf, mode, "just now");
+    }
+
+    const char *unit_label = ww_plural(bucket->singular, bucket->plural, n);
+
+    if (diff < 0) {
+        return ww_buf_appendf(buf, mode, "in %lld %s", (long long)n, unit_label);
+    }
+    return ww_buf_appendf(buf, mode, "%lld %s ago", (long long)n, unit_label);
+}
+
+static bool ww_timeago_write(ww_buf *buf, ww_escape_mode mode, ww_timestamp timestamp,
+                             ww_timestamp reference) {
+    double ts_seconds = 0.0;
+    if (!ww_normalize_timestamp(timestamp, &ts_seconds)) {
+        return false;
+    }
+    double ref_seconds = 0.0;
+    if (!ww_normalize_reference(reference, ts_seconds, &ref_seconds)) {
+        return false;
+    }
+    return ww_timeago_write_seconds(buf, mode, ts_seconds, ref_seconds);
+}
+
+bool timeago_append(ww_buf *buf, ww_escape_mode mode, ww_timestamp timestamp, ww_timestamp reference) {
+    WW_TRACE_ENTRY(timestamp.kind);
+    WW_CAPTURE(ww_capture_pair(WW_CAPTURE_TIMEAGO, mode, timestamp, reference));
+    if (!buf) {
+        WW_TRACE_RETURN(-1);
+        return false;
+    }
+    size_t mark = buf->len;
+    bool ok = ww_buf_finish(buf, mark, ww_timeago_write(buf, mode, timestamp, reference));
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, buf->len - mark));
+    return ok;
+}
+
+char *timeago(ww_timestamp timestamp, ww_timestamp reference) {
+    WW_TRACE_ENTRY(timestamp.kind);
+    ww_buf buf = ww_buf_heap();
+    bool ok = timeago_append(&buf, WW_ESCAPE_NONE, timestamp, reference);
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, buf.len));
+    return ww_buf_detach(&buf, ok);
+}
+
+#define WW_LABEL(s) {s, sizeof(s) - 1}
+
+typedef struct {
+    const char *text;
+    size_t length;
+} ww_label;
+
+static const struct {
+    ww_label name_singular;
+    ww_label name_plural;
+    ww_label compact;
+    int64_t unit_seconds;
+    unsigned flag;
+} ww_duration_units[] = {
+    {WW_LABEL("year"), WW_LABEL("years"), WW_LABEL("y"), 365 * 86400, WW_UNIT_YEAR},
+    {WW_LABEL("month"), WW_LABEL("months"), WW_LABEL("mo"), 30 * 86400, WW_UNIT_MONTH},
+    {WW_LABEL("day"), WW_LABEL("days"), WW_LABEL("d"), 86400, WW_UNIT_DAY},
+    {WW_LABEL("hour"), WW_LABEL("hours"), WW_LABEL("h"), 3600, WW_UNIT_HOUR},
+    {WW_LABEL("minute"), WW_LABEL("minutes"), WW_LABEL("m"), 60, WW_UNIT_MINUTE},
+    {WW_LABEL("second"), WW_LABEL("seconds"), WW_LABEL("s"), 1, WW_UNIT_SECOND},
+};
+
+static ww_duration_spec ww_duration_defaults(void) {
+    ww_duration_spec spec;
+    spec.units = WW_UNIT_ALL;
+    spec.compact = 0;
+    spec.max_units = 2;
+    spec.rounding = WW_DURATION_ROUND_FLOOR;
+    spec.separator = NULL;
+    return spec;
+}
+
+ww_duration_spec ww_duration_spec_default(void) {
+    WW_TRACE_ENTRY(WW_TRACE_NO_KIND);
+    ww_duration_spec spec = ww_duration_defaults();
+    WW_TRACE_RETURN(0);
+    return spec;
+}
+
+static bool ww_duration_compile(const ww_duration_spec *spec, ww_duration_plan *out) {
+    if (!spec || !out || spec->units == 0 || (spec->units & ~WW_UNIT_ALL) != 0 || spec->max_units < 1 ||
+        (spec->rounding != WW_DURATION_ROUND_FLOOR && spec->rounding != WW_DURATION_ROUND_NEAREST)) {
+        return false;
+    }
+    ww_duration_plan plan;
+    plan.count = 0;
+    for (size_t i = 0; i < sizeof(ww_duration_units) / sizeof(ww_duration_units[0]); i++) {
+        if (!(spec->units & ww_duration_units[i].flag)) {
+            continue;
+        }
+        const ww_label *singular = spec->compact ? &ww_duration_units[i].compact : &ww_duration_units[i].name_singular;
+        const ww_label *plural = spec->compact ? &ww_duration_units[i].compact : &ww_duration_units[i].name_plural;
+        plan.divisors[plan.count] = ww_duration_units[i].unit_seconds;
+        plan.labels[plan.count][0] = singular->text;
+        plan.labels[plan.count][1] = plural->text;
+        plan.label_lengths[plan.count][0] = singular->length;
+        plan.label_lengths[plan.count][1] = plural->length;
+        plan.count++;
+    }
+    plan.max_units = (size_t)spec->max_units;
+    plan.rounding = spec->rounding;
+    plan.separator = spec->separator ? spec->separator : (spec->compact ? " " : ", ");
+    plan.separator_length = strlen(plan.separator);
+    plan.value_gap_length = spec->compact ? 0 : 1;
+    *out = plan;
+    return true;
+}
+
+bool ww_duration_format_compile(const ww_duration_spec *spec, ww_duration_plan *out) {
+    WW_TRACE_ENTRY(WW_TRACE_NO_KIND);
+    bool ok = ww_duration_compile(spec, out);
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, 0));
+    return ok;
+}
+
+/* Splits `total` seconds into unit counts. A non-zero `lead` is the count of
+ * the largest unit, already split off in double by the caller; like the
+ * reference implementation, `total` then only fills the smaller units. */
+static void ww_duration_split(const ww_duration_plan *plan, int64_t lead, int64_t total,
+                              int64_t counts[WW_DURATION_MAX_UNITS], size_t *out_first, size_t *out_last) {
+    size_t i = 0;
+    if (lead > 0) {
+        counts[i++] = lead;
+    }
+    for (; i < plan->count; i++) {
+        counts[i] = total / plan->divisors[i];
+        total -= counts[i] * plan->divisors[i];
+    }
+    size_t first = 0;
+    while (first < plan->count && counts[first] == 0) {
+        first++;
+    }
+    size_t last = first + plan->max_units - 1;
+    *out_first = first;
+    *out_last = last < plan->count ? last : plan->count - 1;
+}
+
+static size_t ww_format_count(char out[24], int64_t value) {
+    char digits[24];
+    size_t len = 0;
+    do {
+        digits[len++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    for (size_t i = 0; i < len; i++) {
+        out[i] = digits[len - 1 - i];
+    }
+    return len;
+}
+
+static bool ww_duration_plan_write(const ww_duration_plan *plan, ww_buf *buf, ww_escape_mode mode,
+                                   double seconds) {
+    if (seconds < 0.0 || isnan(seconds) || isinf(seconds)) {
+        return false;
+    }
+    /* Past the int64 range, split off the largest unit in double the way the
+     * spec's reference implementation does, and run the rest through the
+     * integer kernel. */
+    int64_t lead = 0;
+    double small = seconds;
+    if (seconds >= 9.2e18) {
+        double lead_units = floor(seconds / (double)plan->divisors[0]);
+        if (lead_units >= 9.2e18) {
+            return false;
+        }
+        lead = (int64_t)lead_units;
+        small = seconds - lead_units * (double)plan->divisors[0];
+        small = small < 0.0 ? 0.0 : small;
+    }
+    int64_t total = (int64_t)small;
+    int64_t counts[WW_DURATION_MAX_UNITS];
+    size_t first = 0;
+    size_t last = 0;
+    ww_duration_split(plan, lead, total, counts, &first, &last);
+
+    if (first < plan->count && plan->rounding == WW_DURATION_ROUND_NEAREST) {
+        /* Round what is left below the last shown unit, then split again so
+         * a carry (59m 40s -> 1h) moves into the larger units. */
+        int64_t shown = 0;
+        for (size_t i = lead > 0 ? 1 : 0; i <= last; i++) {
+            shown += counts[i] * plan->divisors[i];
+        }
+        double rest = (double)(total - shown) + (small - (double)total);
+        if (2.0 * rest < (double)plan->divisors[last]) {
+            /* Already rounded. */
+        } else if (lead > 0 && last == 0) {
+            ww_duration_split(plan, lead + 1, 0, counts, &first, &last);
+        } else {
+            ww_duration_split(plan, lead, shown + plan->divisors[last], counts, &first, &last);
+        }
+    } else if (first == plan->count && plan->rounding == WW_DURATION_ROUND_NEAREST) {
+        size_t smallest = plan->count - 1;
+        if (2.0 * seconds >= (double)plan->divisors[smallest]) {
+            ww_duration_split(plan, 0, plan->divisors[smallest], counts, &first, &last);
+        }
+    }
+
+    char digits[24];
+    if (first == plan->count) {
+        size_t smallest = plan->count - 1;
+        return ww_buf_append(buf, mode, "0 ", 1 + plan->value_gap_length) &&
+               ww_buf_append(buf, mode, plan->labels[smallest][1], plan->label_lengths[smallest][1]);
+    }
+    bool emitted = false;
+    for (size_t i = first; i <= last; i++) {
+        if (counts[i] == 0) {
+            continue;
+        }
+        size_t form = counts[i] != 1;
+        if ((emitted && !ww_buf_append(buf, mode, plan->separator, plan->separator_length)) ||
+            !ww_buf_append(buf, mode, digits, ww_format_count(digits, counts[i])) ||
+            !ww_buf_append(buf, mode, " ", plan->value_gap_length) ||
+            !ww_buf_append(buf, mode, plan->labels[i][form], plan->label_lengths[i][form])) {
+            return false;
+        }
+        emitted = true;
+    }
+    return true;
+}
+
+bool ww_duration_format_exec(const ww_duration_plan *plan, double seconds, ww_buf *buf) {
+    WW_TRACE_ENTRY(WW_TRACE_NO_KIND);
+    if (!plan || !buf || plan->count == 0) {
+        WW_TRACE_RETURN(-1);
+        return false;
+    }
+    size_t mark = buf->len;
+    bool ok = ww_buf_finish(buf, mark, ww_duration_plan_write(plan, buf, WW_ESCAPE_NONE, seconds));
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, buf->len - mark));
+    return ok;
+}
+
+static ww_duration_plan ww_duration_plan_from_options(const ww_duration_options *options) {
+    ww_duration_spec spec = ww_duration_defaults();
+    if (options) {
+        spec.compact = options->compact;
+        if (options->max_units > 0) {
+            spec.max_units = options->max_units;
+        }
+    }
+    ww_duration_plan plan;
+    ww_duration_compile(&spec, &plan);
+    return plan;
+}
+
+static bool ww_duration_write(ww_buf *buf, ww_escape_mode mode, double seconds,
+                              const ww_duration_options *options) {
+    ww_duration_plan plan = ww_duration_plan_from_options(options);
+    return ww_duration_plan_write(&plan, buf, mode, seconds);
+}
+
+bool duration_append(ww_buf *buf, ww_escape_mode mode, double seconds, const ww_duration_options *options) {
+    WW_TRACE_ENTRY(WW_TRACE_NO_KIND);
+    WW_CAPTURE(ww_capture_duration(mode, seconds, options));
+    if (!buf) {
+        WW_TRACE_RETURN(-1);
+        return false;
+    }
+    size_t mark = buf->len;
+    bool ok = ww_buf_finish(buf, mark, ww_duration_write(buf, mode, seconds, options));
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, buf->len - mark));
+    return ok;
+}
+
+char *duration(double seconds, const ww_duration_options *options) {
+    WW_TRACE_ENTRY(WW_TRACE_NO_KIND);
+    ww_buf buf = ww_buf_heap();
+    bool ok = duration_append(&buf, WW_ESCAPE_NONE, seconds, options);
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, buf.len));
+    return ww_buf_detach(&buf, ok);
+}
+
+#define WW_NANOS_PER_SECOND INT64_C(1000000000)
+
+typedef struct {
+    const char *name;
+    int64_t nanos;
+} ww_unit;
+
+static const ww_unit ww_unit_map[] = {
+    {"s", WW_NANOS_PER_SECOND},
+    {"sec", WW_NANOS_PER_SECOND},
+    {"secs", WW_NANOS_PER_SECOND},
+    {"second", WW_NANOS_PER_SECOND},
+    {"seconds", WW_NANOS_PER_SECOND},
+    {"m", 60 * WW_NANOS_PER_SECOND},
+    {"min", 60 * WW_NANOS_PER_SECOND},
+    {"mins", 60 * WW_NANOS_PER_SECOND},
+    {"minute", 60 * WW_NANOS_PER_SECOND},
+    {"minutes", 60 * WW_NANOS_PER_SECOND},
+    {"h", 3600 * WW_NANOS_PER_SECOND},
+    {"hr", 3600 * WW_NANOS_PER_SECOND},
+    {"hrs", 3600 * WW_NANOS_PER_SECOND},
+    {"hour", 3600 * WW_NANOS_PER_SECOND},
+    {"hours", 3600 * WW_NANOS_PER_SECOND},
+    {"d", 86400 * WW_NANOS_PER_SECOND},
+    {"day", 86400 * WW_NANOS_PER_SECOND},
+    {"days", 86400 * WW_NANOS_PER_SECOND},
+    {"w", 604800 * WW_NANOS_PER_SECOND},
+    {"wk", 604800 * WW_NANOS_PER_SECOND},
+    {"wks", 604800 * WW_NANOS_PER_SECOND},
+    {"week", 604800 * WW_NANOS_PER_SECOND},
+    {"weeks", 604800 * WW_NANOS_PER_SECOND},
+};
+
+/* Sub-second units are parse_duration_ns only; the spec'd parse_duration
+ * grammar stops at seconds. */
+static const ww_unit ww_subsecond_unit_map[] = {
+    {"ns", 1},
+    {"us", 1000},
+    {"ms", 1000000},
+};
+
+static bool ww_is_word(const char *s, const char *word) {
+    size_t len = strlen(word);
+    for (size_t i = 0; i < len; i++) {
+        if (ww_to_lower(s[i]) != word[i]) {
+            return false;
+        }
+    }
+    return !ww_is_alpha(s[len]);
+}
+
+/* h:mm or h:mm:ss, shared by parse_duration and parse_duration_ns.
+ * Whitespace may surround each ':', and only the last field may carry a
+ * fraction. */
+static bool ww_scan_colon_duration(const char *p, ww_decimal parts[3], size_t *out_count) {
+    size_t count = 0;
+    p = ww_skip_space(p);
+    for (;;) {
+        if (count == 3 || !ww_scan_decimal(&p, false, &parts[count])) {
+            return false;
+        }
+        bool whole = p == parts[count].frac;
+        count++;
+        p = ww_skip_space(p);
+        if (*p != ':') {
+            break;
+        }
+        if (!whole) {
+            return false;
+        }
+        p = ww_skip_space(p + 1);
+    }
+    if (count < 2 || *p != '\0') {
+        return false;
+    }
+    *out_count = count;
+    return true;
+}
+
+static bool ww_parse_colon_duration(const char *input, double *out_seconds) {
+    static const double part_seconds[] = {WW_SECONDS_PER_HOUR, WW_SECONDS_PER_MINUTE, 1.0};
+    ww_decimal parts[3];
+    size_t count = 0;
+    if (!ww_scan_colon_duration(input, parts, &count)) {
+        return false;
+    }
+    double total = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        total += ww_decimal_to_double(&parts[i]) * part_seconds[i];
+    }
+    *out_seconds = total;
+    return true;
+}
+
+static bool ww_parse_duration(const char *input, double *out_seconds) {
+    if (!input || !out_seconds) {
+        return false;
+    }
+    if (ww_parse_colon_duration(input, out_seconds)) {
+        WW_PROBE1(parse__duration__path, 0);
+        return true;
+    }
+    WW_PROBE1(parse__duration__path, 1);
+
+    const char *p = input;
+    while (ww_is_space(*p)) {
+        p++;
+    }
+    if (*p == '\0') {
+        return false;
+    }
+
+    double total = 0.0;
+    bool found = false;
+
+    while (*p) {
+        while (*p && (ww_is_space(*p) || *p == ',')) {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
         }
-        char *endptr = NULL;
-        double value = strtod(p, &endptr);
-        if (endptr == p) {
+        if (ww_is_alpha(*p)) {
+            if (ww_is_word(p, "and")) {
+                p += 3;
+                continue;
+            }
             return false;
         }
-        if (value < 0) {
+        ww_decimal decimal;
+        if (!ww_scan_decimal(&p, false, &decimal)) {
             return false;
         }
-        p = endptr;
-        while (*p && isspace((unsigned char)*p)) {
+        double value = ww_decimal_to_double(&decimal);
+        while (*p && ww_is_space(*p)) {
             p++;
         }
-        if (!isalpha((unsigned char)*p)) {
+        if (!ww_is_alpha(*p)) {
             return false;
         }
         char unit_buf[16];
         size_t unit_len = 0;
-        while (*p && isalpha((unsigned char)*p) && unit_len + 1 < sizeof(unit_buf)) {
-            unit_buf[unit_len++] = (char)tolower((unsigned char)*p);
+        while (*p && ww_is_alpha(*p) && unit_len + 1 < sizeof(unit_buf)) {
+            unit_buf[unit_len++] = ww_to_lower(*p);
             p++;
         }
         unit_buf[unit_len] = '\0';
@@ -511,7 +1384,7 @@ bool parse_duration(const char *input, double *out_seconds) {
         bool matched = false;
         for (size_t i = 0; i < sizeof(ww_unit_map) / sizeof(ww_unit_map[0]); i++) {
             if (strcmp(unit_buf, ww_unit_map[i].name) == 0) {
-                multiplier = ww_unit_map[i].multiplier;
+                multiplier = (double)ww_unit_map[i].nanos / (double)WW_NANOS_PER_SECOND;
                 matched = true;
                 break;
             }
@@ -530,94 +1403,1125 @@ bool parse_duration(const char *input, double *out_seconds) {
     return true;
 }
 
-char *human_date(ww_timestamp timestamp, ww_timestamp reference) {
-    double ts_seconds = 0.0;
-    if (!ww_normalize_timestamp(timestamp, &ts_seconds)) {
-        return NULL;
-    }
-    double ref_seconds = ts_seconds;
-    if (reference.kind != WW_TS_NONE) {
-        if (!ww_normalize_timestamp(reference, &ref_seconds)) {
-            return NULL;
-        }
-    }
-    int64_t ts_days = ww_days_from_unix_seconds(ts_seconds);
-    int64_t ref_days = ww_days_from_unix_seconds(ref_seconds);
-    int64_t diff_days = ts_days - ref_days;
+bool parse_duration(const char *input, double *out_seconds) {
+    WW_TRACE_ENTRY(WW_TRACE_NO_KIND);
+    WW_CAPTURE(ww_capture_parse(WW_CAPTURE_PARSE_DURATION, input, NULL));
+    bool ok = ww_parse_duration(input, out_seconds);
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, 0));
+    return ok;
+}
+
+static bool ww_human_date_write_moments(ww_buf *buf, ww_escape_mode mode, ww_moment *ts, ww_moment *ref) {
+    int64_t diff_days = ts->days - ref->days;
 
     if (diff_days == 0) {
-        return ww_strdup("Today");
+        return ww_buf_append_str(buf, mode, "Today");
     }
     if (diff_days == -1) {
-        return ww_strdup("Yesterday");
+        return ww_buf_append_str(buf, mode, "Yesterday");
     }
     if (diff_days == 1) {
-        return ww_strdup("Tomorrow");
+        return ww_buf_append_str(buf, mode, "Tomorrow");
     }
 
     if (diff_days >= -6 && diff_days <= -2) {
-        int weekday = ww_day_of_week_from_days(ts_days);
-        return ww_strdup_printf("Last %s", ww_weekday_names[weekday]);
+        int weekday = ww_day_of_week_from_days(ts->days);
+        return ww_buf_appendf(buf, mode, "Last %s", ww_weekday_names[weekday]);
     }
     if (diff_days >= 2 && diff_days <= 6) {
-        int weekday = ww_day_of_week_from_days(ts_days);
-        return ww_strdup_printf("This %s", ww_weekday_names[weekday]);
+        int weekday = ww_day_of_week_from_days(ts->days);
+        return ww_buf_appendf(buf, mode, "This %s", ww_weekday_names[weekday]);
     }
 
-    int y = 0;
-    unsigned m = 0;
-    unsigned d = 0;
-    int y_ref = 0;
-    unsigned m_ref = 0;
-    unsigned d_ref = 0;
-    ww_civil_from_days(ts_days, &y, &m, &d);
-    ww_civil_from_days(ref_days, &y_ref, &m_ref, &d_ref);
+    ww_moment_civil(ts);
+    ww_moment_civil(ref);
+    if (ts->year == ref->year) {
+        return ww_buf_appendf(buf, mode, "%s %u", ww_month_names[ts->month - 1], ts->day);
+    }
+    return ww_buf_appendf(buf, mode, "%s %u, %d", ww_month_names[ts->month - 1], ts->day, ts->year);
+}
+
+static bool ww_human_date_write_seconds(ww_buf *buf, ww_escape_mode mode, double ts_seconds,
+                                        double ref_seconds) {
+    ww_moment ts = ww_moment_make(ts_seconds);
+    ww_moment ref = ww_moment_make(ref_seconds);
+    return ww_human_date_write_moments(buf, mode, &ts, &ref);
+}
 
-    if (y == y_ref) {
-        return ww_strdup_printf("%s %u", ww_month_names[m - 1], d);
+static bool ww_human_date_write(ww_buf *buf, ww_escape_mode mode, ww_timestamp timestamp,
+                                ww_timestamp reference) {
+    double ts_seconds = 0.0;
+    if (!ww_normalize_timestamp(timestamp, &ts_seconds)) {
+        return false;
     }
-    return ww_strdup_printf("%s %u, %d", ww_month_names[m - 1], d, y);
+    double ref_seconds = 0.0;
+    if (!ww_normalize_reference(reference, ts_seconds, &ref_seconds)) {
+        return false;
+    }
+    return ww_human_date_write_seconds(buf, mode, ts_seconds, ref_seconds);
 }
 
-char *date_range(ww_timestamp start, ww_timestamp end) {
-    double start_seconds = 0.0;
-    double end_seconds = 0.0;
-    if (!ww_normalize_timestamp(start, &start_seconds)) {
-        return NULL;
+bool human_date_append(ww_buf *buf, ww_escape_mode mode, ww_timestamp timestamp, ww_timestamp reference) {
+    WW_TRACE_ENTRY(timestamp.kind);
+    WW_CAPTURE(ww_capture_pair(WW_CAPTURE_HUMAN_DATE, mode, timestamp, reference));
+    if (!buf) {
+        WW_TRACE_RETURN(-1);
+        return false;
     }
-    if (!ww_normalize_timestamp(end, &end_seconds)) {
-        return NULL;
+    size_t mark = buf->len;
+    bool ok = ww_buf_finish(buf, mark, ww_human_date_write(buf, mode, timestamp, reference));
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, buf->len - mark));
+    return ok;
+}
+
+char *human_date(ww_timestamp timestamp, ww_timestamp reference) {
+    WW_TRACE_ENTRY(timestamp.kind);
+    ww_buf buf = ww_buf_heap();
+    bool ok = human_date_append(&buf, WW_ESCAPE_NONE, timestamp, reference);
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, buf.len));
+    return ww_buf_detach(&buf, ok);
+}
+
+typedef enum {
+    WW_RANGE_SAME_DAY,
+    WW_RANGE_SAME_MONTH,
+    WW_RANGE_SAME_YEAR,
+    WW_RANGE_CROSS_YEAR
+} ww_range_shape;
+
+/* Longest output: two "September 30, -2147483648" dates around an en dash. */
+#define WW_DATE_RANGE_MAX 64
+
+static ww_range_shape ww_range_classify(int y1, unsigned m1, unsigned d1, int y2, unsigned m2, unsigned d2) {
+    if (y1 != y2) {
+        return WW_RANGE_CROSS_YEAR;
     }
-    if (start_seconds > end_seconds) {
-        double tmp = start_seconds;
-        start_seconds = end_seconds;
-        end_seconds = tmp;
+    if (m1 != m2) {
+        return WW_RANGE_SAME_YEAR;
+    }
+    return d1 == d2 ? WW_RANGE_SAME_DAY : WW_RANGE_SAME_MONTH;
+}
+
+static size_t ww_put_text(char *out, const char *s) {
+    size_t len = strlen(s);
+    memcpy(out, s, len);
+    return len;
+}
+
+static size_t ww_put_year(char *out, int year) {
+    if (year < 0) {
+        out[0] = '-';
+        return 1 + ww_format_count(out + 1, -(int64_t)year);
     }
+    return ww_format_count(out, year);
+}
+
+/* "Month D" */
+static size_t ww_put_month_day(char *out, unsigned month, unsigned day) {
+    size_t len = ww_put_text(out, ww_month_names[month - 1]);
+    out[len++] = ' ';
+    return len + ww_format_count(out + len, day);
+}
 
-    int64_t start_days = ww_days_from_unix_seconds(start_seconds);
-    int64_t end_days = ww_days_from_unix_seconds(end_seconds);
+/* Formats a range of civil dates without going through printf; the shape
+ * picks which parts of the end date are repeated. */
+static size_t ww_date_range_compose(char out[WW_DATE_RANGE_MAX], ww_range_shape shape, int y1, unsigned m1,
+                                    unsigned d1, int y2, unsigned m2, unsigned d2) {
+    static const char en_dash[] = "\xE2\x80\x93";
+    size_t len = ww_put_month_day(out, m1, d1);
+    switch (shape) {
+    case WW_RANGE_SAME_DAY:
+        break;
+    case WW_RANGE_SAME_MONTH:
+        len += ww_put_text(out + len, en_dash);
+        len += ww_format_count(out + len, d2);
+        break;
+    case WW_RANGE_SAME_YEAR:
+        out[len++] = ' ';
+        len += ww_put_text(out + len, en_dash);
+        out[len++] = ' ';
+        len += ww_put_month_day(out + len, m2, d2);
+        break;
+    case WW_RANGE_CROSS_YEAR:
+        out[len++] = ',';
+        out[len++] = ' ';
+        len += ww_put_year(out + len, y1);
+        out[len++] = ' ';
+        len += ww_put_text(out + len, en_dash);
+        out[len++] = ' ';
+        len += ww_put_month_day(out + len, m2, d2);
+        break;
+    }
+    out[len++] = ',';
+    out[len++] = ' ';
+    return len + ww_put_year(out + len, y2);
+}
 
-    int y1 = 0;
-    unsigned m1 = 0;
-    unsigned d1 = 0;
-    int y2 = 0;
-    unsigned m2 = 0;
-    unsigned d2 = 0;
-    ww_civil_from_days(start_days, &y1, &m1, &d1);
-    ww_civil_from_days(end_days, &y2, &m2, &d2);
+static bool ww_date_range_write_civil(ww_buf *buf, ww_escape_mode mode, int y1, unsigned m1, unsigned d1,
+                                      int y2, unsigned m2, unsigned d2) {
+    char text[WW_DATE_RANGE_MAX];
+    size_t len = ww_date_range_compose(text, ww_range_classify(y1, m1, d1, y2, m2, d2), y1, m1, d1, y2, m2, d2);
+    return ww_buf_append(buf, mode, text, len);
+}
 
-    const char *en_dash = "\xE2\x80\x93";
+static bool ww_date_range_write_moments(ww_buf *buf, ww_escape_mode mode, ww_moment *start, ww_moment *end) {
+    if (start->seconds > end->seconds) {
+        ww_moment *tmp = start;
+        start = end;
+        end = tmp;
+    }
+    ww_moment_civil(start);
+    ww_moment_civil(end);
+    return ww_date_range_write_civil(buf, mode, start->year, start->month, start->day, end->year, end->month,
+                                     end->day);
+}
 
-    if (y1 == y2 && m1 == m2 && d1 == d2) {
-        return ww_strdup_printf("%s %u, %d", ww_month_names[m1 - 1], d1, y1);
+static bool ww_date_range_write(ww_buf *buf, ww_escape_mode mode, ww_timestamp start, ww_timestamp end) {
+    double start_seconds = 0.0;
+    double end_seconds = 0.0;
+    if (!ww_normalize_timestamp(start, &start_seconds)) {
+        return false;
     }
-    if (y1 == y2 && m1 == m2) {
-        return ww_strdup_printf("%s %u%s%u, %d", ww_month_names[m1 - 1], d1, en_dash, d2, y1);
+    if (!ww_normalize_timestamp(end, &end_seconds)) {
+        return false;
     }
-    if (y1 == y2) {
-        return ww_strdup_printf("%s %u %s %s %u, %d", ww_month_names[m1 - 1], d1, en_dash,
-                                ww_month_names[m2 - 1], d2, y1);
+    ww_moment start_moment = ww_moment_make(start_seconds);
+    ww_moment end_moment = ww_moment_make(end_seconds);
+    return ww_date_range_write_moments(buf, mode, &start_moment, &end_moment);
+}
+
+bool date_range_append(ww_buf *buf, ww_escape_mode mode, ww_timestamp start, ww_timestamp end) {
+    WW_TRACE_ENTRY(start.kind);
+    WW_CAPTURE(ww_capture_pair(WW_CAPTURE_DATE_RANGE, mode, start, end));
+    if (!buf) {
+        WW_TRACE_RETURN(-1);
+        return false;
     }
-    return ww_strdup_printf("%s %u, %d %s %s %u, %d", ww_month_names[m1 - 1], d1, y1, en_dash,
-                            ww_month_names[m2 - 1], d2, y2);
+    size_t mark = buf->len;
+    bool ok = ww_buf_finish(buf, mark, ww_date_range_write(buf, mode, start, end));
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, buf->len - mark));
+    return ok;
+}
+
+char *date_range(ww_timestamp start, ww_timestamp end) {
+    WW_TRACE_ENTRY(start.kind);
+    ww_buf buf = ww_buf_heap();
+    bool ok = date_range_append(&buf, WW_ESCAPE_NONE, start, end);
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, buf.len));
+    return ww_buf_detach(&buf, ok);
+}
+
+static bool ww_describe_write(ww_buf *buf, ww_escape_mode mode, ww_timestamp timestamp, ww_timestamp reference,
+                              ww_timestamp end, unsigned flags, ww_description *out) {
+    double ts_seconds = 0.0;
+    double ref_seconds = 0.0;
+    double end_seconds = 0.0;
+    if (!ww_normalize_timestamp(timestamp, &ts_seconds) ||
+        !ww_normalize_reference(reference, ts_seconds, &ref_seconds)) {
+        return false;
+    }
+    if (end.kind == WW_TS_NONE) {
+        end_seconds = ts_seconds;
+    } else if (!ww_normalize_timestamp(end, &end_seconds)) {
+        return false;
+    }
+
+    ww_moment ts = ww_moment_make(ts_seconds);
+    ww_moment ref = ww_moment_make(ref_seconds);
+    ww_moment end_moment = ww_moment_make(end_seconds);
+    size_t start = 0;
+
+    if (flags & WW_DESCRIBE_TIMEAGO) {
+        start = buf->len;
+        if (!ww_timeago_write_seconds(buf, mode, ts_seconds, ref_seconds)) {
+            return false;
+        }
+        out->timeago.offset = start;
+        out->timeago.length = buf->len - start;
+    }
+    if (flags & WW_DESCRIBE_HUMAN_DATE) {
+        start = buf->len;
+        if (!ww_human_date_write_moments(buf, mode, &ts, &ref)) {
+            return false;
+        }
+        out->human_date.offset = start;
+        out->human_date.length = buf->len - start;
+    }
+    if (flags & WW_DESCRIBE_DATE_RANGE) {
+        start = buf->len;
+        if (!ww_date_range_write_moments(buf, mode, &ts, &end_moment)) {
+            return false;
+        }
+        out->date_range.offset = start;
+        out->date_range.length = buf->len - start;
+    }
+    return true;
+}
+
+bool ww_describe(ww_buf *buf, ww_escape_mode mode, ww_timestamp timestamp, ww_timestamp reference,
+                 ww_timestamp end, unsigned flags, ww_description *out) {
+    WW_TRACE_ENTRY(timestamp.kind);
+    if (!buf || !out) {
+        WW_TRACE_RETURN(-1);
+        return false;
+    }
+    memset(out, 0, sizeof(*out));
+    size_t mark = buf->len;
+    bool ok = ww_buf_finish(buf, mark, ww_describe_write(buf, mode, timestamp, reference, end, flags, out));
+    if (!ok) {
+        memset(out, 0, sizeof(*out));
+    }
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, buf->len - mark));
+    return ok;
+}
+
+static bool ww_is_leap_year(int year) {
+    return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+}
+
+static unsigned ww_days_in_month(unsigned month, bool leap) {
+    static const unsigned char lengths[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    return lengths[month - 1] + (month == 2 && leap);
+}
+
+static ww_date ww_date_from_days(int64_t days) {
+    ww_date date;
+    int y = 0;
+    unsigned m = 0;
+    unsigned d = 0;
+    ww_civil_from_days(days, &y, &m, &d);
+    date.days = days;
+    date.year = y;
+    date.month = (uint8_t)m;
+    date.day = (uint8_t)d;
+    date.weekday = (uint8_t)ww_day_of_week_from_days(days);
+    return date;
+}
+
+/* Moves `date` forward by `n` (at most a month of) days using month rollover
+ * instead of a fresh civil conversion. `leap` is `date`'s leap-year flag and
+ * is recomputed only when the year changes. */
+static void ww_date_advance(ww_date *date, bool *leap, int64_t n) {
+    date->days += n;
+    unsigned weekday = date->weekday + (unsigned)n;
+    while (weekday >= 7) {
+        weekday -= 7;
+    }
+    date->weekday = (uint8_t)weekday;
+    int64_t day = (int64_t)date->day + n;
+    unsigned month_length = ww_days_in_month(date->month, *leap);
+    while (day > (int64_t)month_length) {
+        day -= month_length;
+        if (date->month == 12) {
+            date->month = 1;
+            date->year++;
+            *leap = ww_is_leap_year(date->year);
+        } else {
+            date->month++;
+        }
+        month_length = ww_days_in_month(date->month, *leap);
+    }
+    date->day = (uint8_t)day;
+}
+
+/* Bounds past this many seconds from the epoch would put the civil year, or
+ * the year the iterator rolls into, outside `int`. */
+#define WW_CALENDAR_MAX_SECONDS 6.7e16
+
+static bool ww_calendar_init(ww_calendar_iter *iter, ww_timestamp start, ww_timestamp end, ww_calendar_step step) {
+    if (!iter || step < WW_STEP_DAY || step > WW_STEP_MONTH) {
+        return false;
+    }
+    double start_seconds = 0.0;
+    double end_seconds = 0.0;
+    if (!ww_normalize_timestamp(start, &start_seconds) || !ww_normalize_timestamp(end, &end_seconds)) {
+        return false;
+    }
+    if (!(fabs(start_seconds) <= WW_CALENDAR_MAX_SECONDS) || !(fabs(end_seconds) <= WW_CALENDAR_MAX_SECONDS)) {
+        return false;
+    }
+    if (start_seconds > end_seconds) {
+        double tmp = start_seconds;
+        start_seconds = end_seconds;
+        end_seconds = tmp;
+    }
+    iter->current = ww_date_from_days(ww_days_from_unix_seconds(start_seconds));
+    iter->leap = ww_is_leap_year(iter->current.year);
+    iter->end_days = ww_days_from_unix_seconds(end_seconds);
+    iter->step = step;
+    return true;
+}
+
+bool ww_calendar_iter_init(ww_calendar_iter *iter, ww_timestamp start, ww_timestamp end, ww_calendar_step step) {
+    WW_TRACE_ENTRY(start.kind);
+    bool ok = ww_calendar_init(iter, start, end, step);
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, 0));
+    return ok;
+}
+
+bool ww_calendar_iter_next(ww_calendar_iter *iter, ww_date *out_first, ww_date *out_last, char *label,
+                           size_t label_size) {
+    WW_TRACE_ENTRY(WW_TRACE_NO_KIND);
+    if (!iter || iter->current.days > iter->end_days) {
+        WW_TRACE_RETURN(-1);
+        return false;
+    }
+    ww_date first = iter->current;
+    int64_t span = 1;
+    switch (iter->step) {
+    case WW_STEP_WEEK:
+        span = 7;
+        break;
+    case WW_STEP_MONTH:
+        span = (int64_t)ww_days_in_month(first.month, iter->leap) - first.day + 1;
+        break;
+    case WW_STEP_DAY:
+    default:
+        break;
+    }
+    ww_date last = first;
+    int64_t remaining = iter->end_days - first.days;
+    ww_date_advance(&last, &iter->leap, span - 1 < remaining ? span - 1 : remaining);
+    iter->current = last;
+    ww_date_advance(&iter->current, &iter->leap, 1);
+
+    if (out_first) {
+        *out_first = first;
+    }
+    if (out_last) {
+        *out_last = last;
+    }
+    size_t label_len = 0;
+    if (label && label_size > 0) {
+        ww_buf buf = ww_buf_init(label, label_size, NULL);
+        ww_date_range_write_civil(&buf, WW_ESCAPE_NONE, first.year, first.month, first.day, last.year,
+                                  last.month, last.day);
+        label_len = buf.len;
+    }
+    WW_TRACE_RETURN(label_len);
+    return true;
+}
+
+typedef enum {
+    WW_ROW_TIMEAGO,
+    WW_ROW_HUMAN_DATE,
+    WW_ROW_DURATION
+} ww_row_kind;
+
+/* Per-call state shared by every row of a batch: the formatter, its options
+ * and the reference resolved once up front. */
+typedef struct {
+    ww_row_kind kind;
+    double reference;
+    bool reference_is_self;
+    ww_duration_plan duration;
+} ww_row_plan;
+
+static ww_row_plan ww_row_plan_make(ww_row_kind kind, ww_packed_ts reference,
+                                    const ww_duration_options *options) {
+    ww_row_plan plan;
+    plan.kind = kind;
+    plan.reference = reference;
+    plan.reference_is_self = false;
+    if (kind == WW_ROW_DURATION) {
+        plan.duration = ww_duration_plan_from_options(options);
+    }
+    if (kind != WW_ROW_DURATION && !ww_packed_is_set(reference)) {
+        if (WW_ATOMIC_LOAD(&ww_clock.mode) == WW_CLOCK_OFF) {
+            plan.reference_is_self = true;
+        } else {
+            plan.reference = ww_clock_current();
+        }
+    }
+    return plan;
+}
+
+static bool ww_row_accepts(const ww_row_plan *plan, double value) {
+    if (isnan(value) || isinf(value)) {
+        return false;
+    }
+    return plan->kind != WW_ROW_DURATION || value >= 0.0;
+}
+
+static bool ww_row_write(const ww_row_plan *plan, ww_buf *buf, ww_escape_mode mode, double value) {
+    double reference = plan->reference_is_self ? value : plan->reference;
+    switch (plan->kind) {
+    case WW_ROW_TIMEAGO:
+        return ww_timeago_write_seconds(buf, mode, value, reference);
+    case WW_ROW_HUMAN_DATE:
+        return ww_human_date_write_seconds(buf, mode, value, reference);
+    case WW_ROW_DURATION:
+    default:
+        return ww_duration_plan_write(&plan->duration, buf, mode, value);
+    }
+}
+
+/* Renders one row per packed timestamp into `buf`, recording n + 1 offsets so
+ * row i is buf->ptr[offsets[i], offsets[i + 1]). Unset rows are empty. */
+static bool ww_batch_write(const ww_row_plan *plan, ww_buf *buf, ww_escape_mode mode,
+                           const ww_packed_ts *timestamps, size_t n, size_t *offsets) {
+    if (!buf || !offsets || (n > 0 && !timestamps)) {
+        return false;
+    }
+    size_t mark = buf->len;
+    for (size_t i = 0; i < n; i++) {
+        offsets[i] = buf->len;
+        if (!ww_row_accepts(plan, timestamps[i])) {
+            continue;
+        }
+        if (!ww_row_write(plan, buf, mode, timestamps[i])) {
+            return ww_buf_finish(buf, mark, false);
+        }
+    }
+    offsets[n] = buf->len;
+    return true;
+}
+
+bool timeago_batch(ww_buf *buf, ww_escape_mode mode, const ww_packed_ts *timestamps, size_t n,
+                   ww_packed_ts reference, size_t *offsets) {
+    WW_TRACE_ENTRY(WW_TS_UNIX);
+    size_t mark = buf ? buf->len : 0;
+    ww_row_plan plan = ww_row_plan_make(WW_ROW_TIMEAGO, reference, NULL);
+    bool ok = ww_batch_write(&plan, buf, mode, timestamps, n, offsets);
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, buf->len - mark));
+    return ok;
+}
+
+bool human_date_batch(ww_buf *buf, ww_escape_mode mode, const ww_packed_ts *timestamps, size_t n,
+                      ww_packed_ts reference, size_t *offsets) {
+    WW_TRACE_ENTRY(WW_TS_UNIX);
+    size_t mark = buf ? buf->len : 0;
+    ww_row_plan plan = ww_row_plan_make(WW_ROW_HUMAN_DATE, reference, NULL);
+    bool ok = ww_batch_write(&plan, buf, mode, timestamps, n, offsets);
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, buf->len - mark));
+    return ok;
+}
+
+#define WW_RANGE_BLOCK 64
+
+/* Works in blocks of pairs, one pass per stage: order each pair and reduce it
+ * to day numbers, decompose all day numbers to civil dates, then classify and
+ * emit. The first two passes are straight-line loops over local arrays. */
+static bool ww_date_range_batch_write(ww_buf *buf, ww_escape_mode mode, const ww_packed_ts *starts,
+                                      const ww_packed_ts *ends, size_t n, size_t *offsets) {
+    if (!buf || !offsets || (n > 0 && (!starts || !ends))) {
+        return false;
+    }
+    size_t mark = buf->len;
+    int64_t days[2 * WW_RANGE_BLOCK];
+    int years[2 * WW_RANGE_BLOCK];
+    unsigned months[2 * WW_RANGE_BLOCK];
+    unsigned month_days[2 * WW_RANGE_BLOCK];
+    bool valid[WW_RANGE_BLOCK];
+    for (size_t base = 0; base < n; base += WW_RANGE_BLOCK) {
+        size_t count = n - base < WW_RANGE_BLOCK ? n - base : WW_RANGE_BLOCK;
+        for (size_t i = 0; i < count; i++) {
+            double start = starts[base + i];
+            double end = ends[base + i];
+            valid[i] = !isnan(start) && !isinf(start) && !isnan(end) && !isinf(end);
+            if (!valid[i]) {
+                start = 0.0;
+                end = 0.0;
+            }
+            days[i] = ww_days_from_unix_seconds(start < end ? start : end);
+            days[WW_RANGE_BLOCK + i] = ww_days_from_unix_seconds(start < end ? end : start);
+        }
+        for (size_t i = 0; i < count; i++) {
+            size_t j = WW_RANGE_BLOCK + i;
+            ww_civil_from_days(days[i], &years[i], &months[i], &month_days[i]);
+            ww_civil_from_days(days[j], &years[j], &months[j], &month_days[j]);
+        }
+        for (size_t i = 0; i < count; i++) {
+            offsets[base + i] = buf->len;
+            if (!valid[i]) {
+                continue;
+            }
+            size_t j = WW_RANGE_BLOCK + i;
+            char text[WW_DATE_RANGE_MAX];
+            ww_range_shape shape =
+                ww_range_classify(years[i], months[i], month_days[i], years[j], months[j], month_days[j]);
+            size_t len = ww_date_range_compose(text, shape, years[i], months[i], month_days[i], years[j],
+                                               months[j], month_days[j]);
+            if (!ww_buf_append(buf, mode, text, len)) {
+                return ww_buf_finish(buf, mark, false);
+            }
+        }
+    }
+    offsets[n] = buf->len;
+    return true;
+}
+
+bool date_range_batch(ww_buf *buf, ww_escape_mode mode, const ww_packed_ts *starts, const ww_packed_ts *ends,
+                      size_t n, size_t *offsets) {
+    WW_TRACE_ENTRY(WW_TS_UNIX);
+    size_t mark = buf ? buf->len : 0;
+    bool ok = ww_date_range_batch_write(buf, mode, starts, ends, n, offsets);
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, buf->len - mark));
+    return ok;
+}
+
+#define WW_COLUMN_BYTES_PER_ROW_ESTIMATE 16
+
+static bool ww_column_value(const ww_column *column, size_t i, double *out) {
+    size_t index = column->offset + i;
+    if (column->validity && !(column->validity[index / 8] & (1u << (index % 8)))) {
+        return false;
+    }
+    if (column->i64) {
+        int64_t ticks = column->i64[index];
+        if (column->ticks_per_second > 1) {
+            int64_t whole = ticks / column->ticks_per_second;
+            int64_t frac = ticks % column->ticks_per_second;
+            *out = (double)whole + (double)frac / (double)column->ticks_per_second;
+        } else {
+            *out = (double)ticks;
+        }
+        return true;
+    }
+    if (column->f64) {
+        *out = column->f64[index];
+        return true;
+    }
+    return false;
+}
+
+static void ww_bitmap_set(uint8_t *bitmap, size_t i, bool value) {
+    if (!bitmap) {
+        return;
+    }
+    if (value) {
+        bitmap[i / 8] |= (uint8_t)(1u << (i % 8));
+    } else {
+        bitmap[i / 8] &= (uint8_t)~(1u << (i % 8));
+    }
+}
+
+/* Renders a column into one contiguous UTF-8 buffer with Arrow-style int32
+ * offsets. Null inputs and rows the formatter rejects become null outputs. */
+static bool ww_column_write(const ww_row_plan *plan, const ww_column *column, ww_buf *data,
+                            int32_t *offsets, uint8_t *validity) {
+    if (!column || !data || !offsets || (column->i64 && column->ticks_per_second < 1)) {
+        return false;
+    }
+    size_t n = column->length;
+    size_t mark = data->len;
+    if (n <= (SIZE_MAX - data->len) / WW_COLUMN_BYTES_PER_ROW_ESTIMATE) {
+        ww_buf_reserve(data, n * WW_COLUMN_BYTES_PER_ROW_ESTIMATE);
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (data->len > INT32_MAX) {
+            return ww_buf_finish(data, mark, false);
+        }
+        offsets[i] = (int32_t)data->len;
+        double value = 0.0;
+        bool valid = ww_column_value(column, i, &value) && ww_row_accepts(plan, value);
+        if (valid && !ww_row_write(plan, data, WW_ESCAPE_NONE, value)) {
+            return ww_buf_finish(data, mark, false);
+        }
+        ww_bitmap_set(validity, i, valid);
+    }
+    if (data->len > INT32_MAX) {
+        return ww_buf_finish(data, mark, false);
+    }
+    offsets[n] = (int32_t)data->len;
+    return true;
+}
+
+bool timeago_column(const ww_column *timestamps, ww_packed_ts reference, ww_buf *data, int32_t *offsets,
+                    uint8_t *validity) {
+    WW_TRACE_ENTRY(WW_TRACE_NO_KIND);
+    size_t mark = data ? data->len : 0;
+    ww_row_plan plan = ww_row_plan_make(WW_ROW_TIMEAGO, reference, NULL);
+    bool ok = ww_column_write(&plan, timestamps, data, offsets, validity);
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, data->len - mark));
+    return ok;
+}
+
+bool human_date_column(const ww_column *timestamps, ww_packed_ts reference, ww_buf *data, int32_t *offsets,
+                       uint8_t *validity) {
+    WW_TRACE_ENTRY(WW_TRACE_NO_KIND);
+    size_t mark = data ? data->len : 0;
+    ww_row_plan plan = ww_row_plan_make(WW_ROW_HUMAN_DATE, reference, NULL);
+    bool ok = ww_column_write(&plan, timestamps, data, offsets, validity);
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, data->len - mark));
+    return ok;
+}
+
+bool duration_column(const ww_column *seconds, const ww_duration_options *options, ww_buf *data,
+                     int32_t *offsets, uint8_t *validity) {
+    WW_TRACE_ENTRY(WW_TRACE_NO_KIND);
+    size_t mark = data ? data->len : 0;
+    ww_row_plan plan = ww_row_plan_make(WW_ROW_DURATION, 0.0, options);
+    bool ok = ww_column_write(&plan, seconds, data, offsets, validity);
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, data->len - mark));
+    return ok;
+}
+
+static size_t ww_match_keyword(const char *s, const char *word) {
+    size_t len = strlen(word);
+    for (size_t i = 0; i < len; i++) {
+        if (ww_to_lower(s[i]) != ww_to_lower(word[i])) {
+            return 0;
+        }
+    }
+    return ww_is_alpha(s[len]) ? 0 : len;
+}
+
+static int ww_match_keyword_table(const char *s, const char **table, size_t count, size_t *out_len) {
+    for (size_t i = 0; i < count; i++) {
+        size_t len = ww_match_keyword(s, table[i]);
+        if (len > 0) {
+            *out_len = len;
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+/* Matches a timeago unit word against the bucket table, returning the index of
+ * the first bucket using that unit. Like ww_plural, only a count of 1 takes
+ * the singular form. */
+static int ww_match_timeago_unit(const char *s, int64_t n, size_t *out_len) {
+    for (size_t i = 0; i < WW_TIMEAGO_BUCKET_COUNT; i++) {
+        const ww_timeago_bucket *bucket = &ww_timeago_buckets[i];
+        if (!bucket->singular) {
+            continue;
+        }
+        size_t len = ww_match_keyword(s, ww_plural(bucket->singular, bucket->plural, n));
+        if (len > 0) {
+            *out_len = len;
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+/* Computes the [lo, hi) range of absolute differences that timeago renders as
+ * `n` of the unit used by bucket `first`, to within a few ulps: rounding
+ * boundaries carry WW_ROUND_HALF_TOLERANCE, and ww_timeago_refine settles the
+ * exact ends. Counts past 2^52 are rejected, since every larger double is
+ * already a whole number and could not have been rounded to `n`. */
+static bool ww_timeago_abs_range(size_t first, int64_t n, double *out_lo, double *out_hi) {
+    const char *unit = ww_timeago_buckets[first].singular;
+    if ((double)n > 4503599627370496.0) {
+        return false;
+    }
+    bool found = false;
+    double lo = 0.0;
+    double hi = 0.0;
+    for (size_t i = first; i < WW_TIMEAGO_BUCKET_COUNT; i++) {
+        const ww_timeago_bucket *bucket = &ww_timeago_buckets[i];
+        if (strcmp(bucket->singular, unit) != 0) {
+            break;
+        }
+        double bucket_lo = ww_timeago_buckets[i - 1].upper;
+        double bucket_hi = bucket->upper;
+        if (bucket->divisor > 0.0) {
+            double round_lo = ((double)n - 0.5 - WW_ROUND_HALF_TOLERANCE) * bucket->divisor;
+            double round_hi = ((double)n + 0.5 - WW_ROUND_HALF_TOLERANCE) * bucket->divisor;
+            if (round_lo > bucket_lo) {
+                bucket_lo = round_lo;
+            }
+            if (round_hi < bucket_hi) {
+                bucket_hi = round_hi;
+            }
+        } else if (n != 1) {
+            continue;
+        }
+        if (bucket_lo >= bucket_hi) {
+            continue;
+        }
+        if (!found) {
+            lo = bucket_lo;
+            hi = bucket_hi;
+            found = true;
+        } else {
+            lo = bucket_lo < lo ? bucket_lo : lo;
+            hi = bucket_hi > hi ? bucket_hi : hi;
+        }
+    }
+    if (!found) {
+        return false;
+    }
+    *out_lo = lo;
+    *out_hi = hi;
+    return true;
+}
+
+static bool ww_timeago_renders(double ts_seconds, double ref_seconds, const char *unit, int64_t n, bool future) {
+    double diff = ref_seconds - ts_seconds;
+    int64_t got = 0;
+    const ww_timeago_bucket *bucket = &ww_timeago_buckets[ww_timeago_classify(fabs(diff), &got)];
+    return bucket->singular && strcmp(bucket->singular, unit) == 0 && got == n && (diff < 0) == future;
+}
+
+/* Moves the ends of a timestamp range from ww_timeago_abs_range onto the
+ * exact doubles where the rendered phrase changes, so lo renders the phrase
+ * and hi is the first double above it that does not. */
+static void ww_timeago_refine(double ref_seconds, const char *unit, int64_t n, bool future, double *lo, double *hi) {
+    while (ww_timeago_renders(nextafter(*lo, -HUGE_VAL), ref_seconds, unit, n, future)) {
+        *lo = nextafter(*lo, -HUGE_VAL);
+    }
+    while (*lo < *hi && !ww_timeago_renders(*lo, ref_seconds, unit, n, future)) {
+        *lo = nextafter(*lo, HUGE_VAL);
+    }
+    while (ww_timeago_renders(*hi, ref_seconds, unit, n, future)) {
+        *hi = nextafter(*hi, HUGE_VAL);
+    }
+    while (*hi > *lo && !ww_timeago_renders(nextafter(*hi, -HUGE_VAL), ref_seconds, unit, n, future)) {
+        *hi = nextafter(*hi, -HUGE_VAL);
+    }
+}
+
+static bool ww_parse_relative_phrase(const char *p, double ref_seconds, double *out_lo, double *out_hi) {
+    size_t len = 0;
+    if ((len = ww_match_keyword(p, "just")) > 0) {
+        p = ww_skip_space(p + len);
+        if ((len = ww_match_keyword(p, "now")) == 0 || *ww_skip_space(p + len) != '\0') {
+            return false;
+        }
+        *out_lo = nextafter(ref_seconds - ww_timeago_buckets[0].upper, HUGE_VAL);
+        *out_hi = ref_seconds + ww_timeago_buckets[0].upper;
+        return true;
+    }
+
+    bool future = false;
+    if ((len = ww_match_keyword(p, "in")) > 0) {
+        future = true;
+        p = ww_skip_space(p + len);
+    }
+    int64_t n = 0;
+    if (!ww_scan_count(&p, &n)) {
+        return false;
+    }
+    p = ww_skip_space(p);
+    int bucket = ww_match_timeago_unit(p, n, &len);
+    if (bucket < 0) {
+        return false;
+    }
+    p = ww_skip_space(p + len);
+    if (!future) {
+        if ((len = ww_match_keyword(p, "ago")) == 0) {
+            return false;
+        }
+        p = ww_skip_space(p + len);
+    }
+    if (*p != '\0') {
+        return false;
+    }
+
+    double lo = 0.0;
+    double hi = 0.0;
+    if (!ww_timeago_abs_range((size_t)bucket, n, &lo, &hi)) {
+        return false;
+    }
+    /* The difference range is [lo, hi); in the past it maps to timestamps
+     * (ref - hi, ref - lo], so both ends step up to keep [lo, hi). */
+    if (future) {
+        *out_lo = ref_seconds + lo;
+        *out_hi = ref_seconds + hi;
+    } else {
+        *out_lo = nextafter(ref_seconds - hi, HUGE_VAL);
+        *out_hi = nextafter(ref_seconds - lo, HUGE_VAL);
+    }
+    ww_timeago_refine(ref_seconds, ww_timeago_buckets[bucket].singular, n, future, out_lo, out_hi);
+    return true;
+}
+
+static bool ww_parse_calendar_phrase(const char *p, double ref_seconds, double *out_lo, double *out_hi) {
+    static const char *relative_days[] = {"Yesterday", "Today", "Tomorrow"};
+    static const char *relative_weeks[] = {"Last", "This"};
+    int64_t ref_days = ww_days_from_unix_seconds(ref_seconds);
+    int64_t days = 0;
+    size_t len = 0;
+    int idx = 0;
+
+    if ((idx = ww_match_keyword_table(p, relative_days, 3, &len)) >= 0) {
+        days = ref_days + idx - 1;
+        p += len;
+    } else if ((idx = ww_match_keyword_table(p, relative_weeks, 2, &len)) >= 0) {
+        p = ww_skip_space(p + len);
+        int weekday = ww_match_keyword_table(p, ww_weekday_names, 7, &len);
+        if (weekday < 0) {
+            return false;
+        }
+        p += len;
+        int64_t step = idx == 0 ? -1 : 1;
+        days = ref_days + 2 * step;
+        while (ww_day_of_week_from_days(days) != weekday) {
+            days += step;
+        }
+        if ((days - ref_days) * step > 6) {
+            return false;
+        }
+    } else if ((idx = ww_match_keyword_table(p, ww_month_names, 12, &len)) >= 0) {
+        p = ww_skip_space(p + len);
+        int64_t day = 0;
+        if (!ww_scan_count(&p, &day) || day < 1 || day > 31) {
+            return false;
+        }
+        int y_ref = 0;
+        unsigned m_ref = 0;
+        unsigned d_ref = 0;
+        ww_civil_from_days(ref_days, &y_ref, &m_ref, &d_ref);
+        int year = y_ref;
+        bool has_year = false;
+        const char *q = ww_skip_space(p);
+        if (*q == ',') {
+            q = ww_skip_space(q + 1);
+            bool negative = *q == '-';
+            int64_t year_value = 0;
+            if (negative) {
+                q++;
+            }
+            if (!ww_scan_count(&q, &year_value) || year_value > 9999999) {
+                return false;
+            }
+            year = negative ? -(int)year_value : (int)year_value;
+            has_year = true;
+            p = q;
+        }
+        days = ww_days_from_civil(year, (unsigned)idx + 1, (unsigned)day);
+        int y_check = 0;
+        unsigned m_check = 0;
+        unsigned d_check = 0;
+        ww_civil_from_days(days, &y_check, &m_check, &d_check);
+        if (d_check != (unsigned)day) {
+            return false;
+        }
+        /* human_date only spells out dates that fall outside the relative
+         * window, and only includes the year when it differs. */
+        int64_t diff_days = days - ref_days;
+        if ((diff_days >= -6 && diff_days <= 6) || has_year == (year == y_ref)) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    if (*ww_skip_space(p) != '\0') {
+        return false;
+    }
+    *out_lo = (double)days * WW_SECONDS_PER_DAY;
+    *out_hi = *out_lo + WW_SECONDS_PER_DAY;
+    return true;
+}
+
+static bool ww_parse_timeago(const char *input, ww_timestamp reference, double *out_lo, double *out_hi) {
+    if (!input || !out_lo || !out_hi) {
+        return false;
+    }
+    double ref_seconds = 0.0;
+    if (reference.kind == WW_TS_NONE && WW_ATOMIC_LOAD(&ww_clock.mode) == WW_CLOCK_OFF) {
+        return false;
+    }
+    if (!ww_normalize_reference(reference, 0.0, &ref_seconds)) {
+        return false;
+    }
+    const char *p = ww_skip_space(input);
+    if (ww_parse_relative_phrase(p, ref_seconds, out_lo, out_hi)) {
+        return true;
+    }
+    return ww_parse_calendar_phrase(p, ref_seconds, out_lo, out_hi);
+}
+
+bool parse_timeago(const char *input, ww_timestamp reference, double *out_lo, double *out_hi) {
+    WW_TRACE_ENTRY(reference.kind);
+    WW_CAPTURE(ww_capture_parse(WW_CAPTURE_PARSE_TIMEAGO, input, &reference));
+    bool ok = ww_parse_timeago(input, reference, out_lo, out_hi);
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, 0));
+    return ok;
+}
+
+/* Returns floor(value * unit_nanos) exactly. The fraction is folded in with
+ * Horner's rule from the last digit, which keeps every step below
+ * 10 * unit_nanos. */
+static bool ww_decimal_to_nanos(const ww_decimal *value, int64_t unit_nanos, int64_t *out) {
+    if (value->whole > INT64_MAX / unit_nanos) {
+        return false;
+    }
+    int64_t frac_nanos = 0;
+    for (size_t i = value->frac_len; i > 0; i--) {
+        frac_nanos = (frac_nanos + (int64_t)(value->frac[i - 1] - '0') * unit_nanos) / 10;
+    }
+    int64_t whole_nanos = value->whole * unit_nanos;
+    if (whole_nanos > INT64_MAX - frac_nanos) {
+        return false;
+    }
+    *out = whole_nanos + frac_nanos;
+    return true;
+}
+
+static bool ww_add_nanos(int64_t *total, int64_t value) {
+    if (*total > INT64_MAX - value) {
+        return false;
+    }
+    *total += value;
+    return true;
+}
+
+static bool ww_lookup_unit_nanos(const char **p, int64_t *out) {
+    const char *s = *p;
+    /* Go spells microseconds with U+00B5 or U+03BC. */
+    if ((((unsigned char)s[0] == 0xC2 && (unsigned char)s[1] == 0xB5) ||
+         ((unsigned char)s[0] == 0xCE && (unsigned char)s[1] == 0xBC)) &&
+        (s[2] == 's' || s[2] == 'S') && !ww_is_alpha(s[3])) {
+        *out = 1000;
+        *p = s + 3;
+        return true;
+    }
+    char unit_buf[16];
+    size_t unit_len = 0;
+    while (ww_is_alpha(s[unit_len])) {
+        if (unit_len + 1 >= sizeof(unit_buf)) {
+            return false;
+        }
+        unit_buf[unit_len] = ww_to_lower(s[unit_len]);
+        unit_len++;
+    }
+    unit_buf[unit_len] = '\0';
+    for (size_t i = 0; unit_len > 0 && i < sizeof(ww_subsecond_unit_map) / sizeof(ww_subsecond_unit_map[0]); i++) {
+        if (strcmp(unit_buf, ww_subsecond_unit_map[i].name) == 0) {
+            *out = ww_subsecond_unit_map[i].nanos;
+            *p = s + unit_len;
+            return true;
+        }
+    }
+    for (size_t i = 0; unit_len > 0 && i < sizeof(ww_unit_map) / sizeof(ww_unit_map[0]); i++) {
+        if (strcmp(unit_buf, ww_unit_map[i].name) == 0) {
+            *out = ww_unit_map[i].nanos;
+            *p = s + unit_len;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* PnYnMnWnDTnHnMnS, with years as 365 days and months as 30 days to match
+ * duration(). Components must appear in order. */
+static bool ww_parse_iso_duration_ns(const char *p, int64_t *out_ns) {
+    static const char designators[] = "YMWDHMS";
+    static const int64_t designator_nanos[] = {
+        365 * 86400 * WW_NANOS_PER_SECOND, 30 * 86400 * WW_NANOS_PER_SECOND, 7 * 86400 * WW_NANOS_PER_SECOND,
+        86400 * WW_NANOS_PER_SECOND,       3600 * WW_NANOS_PER_SECOND,       60 * WW_NANOS_PER_SECOND,
+        WW_NANOS_PER_SECOND};
+    size_t next = 0;
+    bool in_time = false;
+    bool any = false;
+    bool time_any = false;
+    int64_t total = 0;
+    p++;
+    while (*p && !ww_is_space(*p)) {
+        if ((*p == 'T' || *p == 't') && !in_time) {
+            in_time = true;
+            next = 4;
+            p++;
+            continue;
+        }
+        ww_decimal value;
+        if (!ww_scan_decimal(&p, true, &value)) {
+            return false;
+        }
+        char designator = ww_to_upper(*p);
+        size_t index = in_time ? 4 : 0;
+        size_t limit = in_time ? 7 : 4;
+        while (index < limit && designators[index] != designator) {
+            index++;
+        }
+        int64_t nanos = 0;
+        if (index == limit || index < next || !ww_decimal_to_nanos(&value, designator_nanos[index], &nanos) ||
+            !ww_add_nanos(&total, nanos)) {
+            return false;
+        }
+        next = index + 1;
+        any = true;
+        time_any = time_any || in_time;
+        p++;
+    }
+    if (!any || (in_time && !time_any) || *ww_skip_space(p) != '\0') {
+        return false;
+    }
+    *out_ns = total;
+    return true;
+}
+
+static bool ww_parse_colon_duration_ns(const char *p, int64_t *out_ns) {
+    static const int64_t part_nanos[] = {3600 * WW_NANOS_PER_SECOND, 60 * WW_NANOS_PER_SECOND,
+                                         WW_NANOS_PER_SECOND};
+    ww_decimal parts[3];
+    size_t count = 0;
+    if (!ww_scan_colon_duration(p, parts, &count)) {
+        return false;
+    }
+    int64_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        int64_t nanos = 0;
+        if (!ww_decimal_to_nanos(&parts[i], part_nanos[i], &nanos) || !ww_add_nanos(&total, nanos)) {
+            return false;
+        }
+    }
+    *out_ns = total;
+    return true;
+}
+
+static bool ww_parse_duration_ns(const char *input, int64_t *out_ns) {
+    if (!input || !out_ns) {
+        return false;
+    }
+    const char *p = ww_skip_space(input);
+    if (*p == '\0') {
+        return false;
+    }
+    if (*p == 'P' || *p == 'p') {
+        WW_PROBE1(parse__duration__path, 2);
+        return ww_parse_iso_duration_ns(p, out_ns);
+    }
+    if (strchr(p, ':')) {
+        WW_PROBE1(parse__duration__path, 0);
+        return ww_parse_colon_duration_ns(p, out_ns);
+    }
+    WW_PROBE1(parse__duration__path, 1);
+
+    int64_t total = 0;
+    bool found = false;
+    while (*p) {
+        while (*p && (ww_is_space(*p) || *p == ',')) {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        if (ww_is_alpha(*p)) {
+            if (ww_is_word(p, "and")) {
+                p += 3;
+                continue;
+            }
+            return false;
+        }
+        ww_decimal value;
+        int64_t unit_nanos = 0;
+        int64_t nanos = 0;
+        if (!ww_scan_decimal(&p, false, &value)) {
+            return false;
+        }
+        p = ww_skip_space(p);
+        if (!ww_lookup_unit_nanos(&p, &unit_nanos) || !ww_decimal_to_nanos(&value, unit_nanos, &nanos) ||
+            !ww_add_nanos(&total, nanos)) {
+            return false;
+        }
+        found = true;
+    }
+    if (!found) {
+        return false;
+    }
+    *out_ns = total;
+    return true;
+}
+
+bool parse_duration_ns(const char *input, int64_t *out_ns) {
+    WW_TRACE_ENTRY(WW_TRACE_NO_KIND);
+    WW_CAPTURE(ww_capture_parse(WW_CAPTURE_PARSE_DURATION_NS, input, NULL));
+    bool ok = ww_parse_duration_ns(input, out_ns);
+    WW_TRACE_RETURN(WW_TRACE_LEN(ok, 0));
+    return ok;
 }
@@ -2,6 +2,8 @@
 #define WHENWORDS_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <time.h>
 
 #ifdef __cplusplus
@@ -58,6 +60,96 @@ static inline ww_timestamp ww_timestamp_unset(void) {
     return ts;
 }
 
+/* Compact 8-byte timestamp: normalized Unix seconds, with NaN marking an
+ * unset or invalid value. */
+typedef double ww_packed_ts;
+
+static inline bool ww_packed_is_set(ww_packed_ts ts) {
+    return ts == ts;
+}
+
+static inline ww_timestamp ww_timestamp_from_packed(ww_packed_ts ts) {
+    return ww_packed_is_set(ts) ? ww_timestamp_from_unix(ts) : ww_timestamp_unset();
+}
+
+ww_packed_ts ww_timestamp_pack(ww_timestamp ts);
+size_t ww_timestamp_pack_array(const ww_timestamp *in, size_t n, ww_packed_ts *out);
+
+/* Read-only view of an Arrow-style numeric column. Exactly one of `i64` or
+ * `f64` is set; `validity` is an optional LSB-first bitmap. `offset` applies
+ * to both the values and the bitmap. */
+typedef struct {
+    const int64_t *i64;
+    const double *f64;
+    const uint8_t *validity;
+    size_t offset;
+    size_t length;
+    int64_t ticks_per_second;
+} ww_column;
+
+static inline ww_column ww_column_from_int64(const int64_t *values, const uint8_t *validity, size_t length,
+                                             int64_t ticks_per_second) {
+    ww_column column;
+    column.i64 = values;
+    column.f64 = NULL;
+    column.validity = validity;
+    column.offset = 0;
+    column.length = length;
+    column.ticks_per_second = ticks_per_second;
+    return column;
+}
+
+static inline ww_column ww_column_from_double(const double *values, const uint8_t *validity, size_t length) {
+    ww_column column;
+    column.i64 = NULL;
+    column.f64 = values;
+    column.validity = validity;
+    column.offset = 0;
+    column.length = length;
+    column.ticks_per_second = 1;
+    return column;
+}
+
+typedef enum {
+    WW_CLOCK_OFF,
+    WW_CLOCK_COARSE,
+    WW_CLOCK_CACHED
+} ww_clock_mode;
+
+void ww_clock_set_mode(ww_clock_mode mode);
+void ww_clock_set(double unix_seconds);
+double ww_clock_refresh(void);
+double ww_clock_now(void);
+
+typedef enum {
+    WW_ESCAPE_NONE,
+    WW_ESCAPE_JSON,
+    WW_ESCAPE_HTML
+} ww_escape_mode;
+
+typedef void *(*ww_realloc_fn)(void *ptr, size_t size);
+
+/* Caller-owned output buffer. `ptr[len]` is kept NUL-terminated whenever
+ * `cap > 0`. A NULL `realloc_fn` makes the buffer fixed-size. */
+typedef struct {
+    char *ptr;
+    size_t len;
+    size_t cap;
+    ww_realloc_fn realloc_fn;
+} ww_buf;
+
+static inline ww_buf ww_buf_init(char *ptr, size_t cap, ww_realloc_fn realloc_fn) {
+    ww_buf buf;
+    buf.ptr = ptr;
+    buf.len = 0;
+    buf.cap = ptr ? cap : 0;
+    buf.realloc_fn = realloc_fn;
+    if (buf.cap > 0) {
+        buf.ptr[0] = '\0';
+    }
+    return buf;
+}
+
 typedef struct {
     int compact;
     int max_units;
@@ -65,11 +157,140 @@ typedef struct {
 
 ww_duration_options ww_duration_options_default(void);
 
+#define WW_UNIT_YEAR 0x01u
+#define WW_UNIT_MONTH 0x02u
+#define WW_UNIT_DAY 0x04u
+#define WW_UNIT_HOUR 0x08u
+#define WW_UNIT_MINUTE 0x10u
+#define WW_UNIT_SECOND 0x20u
+#define WW_UNIT_ALL 0x3fu
+
+#define WW_DURATION_MAX_UNITS 6
+
+typedef enum {
+    WW_DURATION_ROUND_FLOOR,
+    WW_DURATION_ROUND_NEAREST
+} ww_duration_rounding;
+
+typedef struct {
+    unsigned units;
+    int compact;
+    int max_units;
+    ww_duration_rounding rounding;
+    const char *separator;
+} ww_duration_spec;
+
+/* Compiled form of a ww_duration_spec. Treat as opaque; `separator` points
+ * into the spec's string, which must outlive the plan. */
+typedef struct {
+    size_t count;
+    size_t max_units;
+    ww_duration_rounding rounding;
+    int64_t divisors[WW_DURATION_MAX_UNITS];
+    const char *labels[WW_DURATION_MAX_UNITS][2];
+    size_t label_lengths[WW_DURATION_MAX_UNITS][2];
+    const char *separator;
+    size_t separator_length;
+    size_t value_gap_length;
+} ww_duration_plan;
+
+ww_duration_spec ww_duration_spec_default(void);
+
 char *timeago(ww_timestamp timestamp, ww_timestamp reference);
 char *duration(double seconds, const ww_duration_options *options);
+bool ww_duration_format_compile(const ww_duration_spec *spec, ww_duration_plan *out);
+bool ww_duration_format_exec(const ww_duration_plan *plan, double seconds, ww_buf *buf);
 bool parse_duration(const char *input, double *out_seconds);
+bool parse_duration_ns(const char *input, int64_t *out_ns);
 char *human_date(ww_timestamp timestamp, ww_timestamp reference);
 char *date_range(ww_timestamp start, ww_timestamp end);
+bool timeago_append(ww_buf *buf, ww_escape_mode mode, ww_timestamp timestamp, ww_timestamp reference);
+bool duration_append(ww_buf *buf, ww_escape_mode mode, double seconds, const ww_duration_options *options);
+bool human_date_append(ww_buf *buf, ww_escape_mode mode, ww_timestamp timestamp, ww_timestamp reference);
+bool date_range_append(ww_buf *buf, ww_escape_mode mode, ww_timestamp start, ww_timestamp end);
+
+bool timeago_batch(ww_buf *buf, ww_escape_mode mode, const ww_packed_ts *timestamps, size_t n,
+                   ww_packed_ts reference, size_t *offsets);
+bool human_date_batch(ww_buf *buf, ww_escape_mode mode, const ww_packed_ts *timestamps, size_t n,
+                      ww_packed_ts reference, size_t *offsets);
+bool date_range_batch(ww_buf *buf, ww_escape_mode mode, const ww_packed_ts *starts, const ww_packed_ts *ends,
+                      size_t n, size_t *offsets);
+
+bool timeago_column(const ww_column *timestamps, ww_packed_ts reference, ww_buf *data, int32_t *offsets,
+                    uint8_t *validity);
+bool human_date_column(const ww_column *timestamps, ww_packed_ts reference, ww_buf *data, int32_t *offsets,
+                       uint8_t *validity);
+bool duration_column(const ww_column *seconds, const ww_duration_options *options, ww_buf *data,
+                     int32_t *offsets, uint8_t *validity);
+
+#define WW_DESCRIBE_TIMEAGO 0x1u
+#define WW_DESCRIBE_HUMAN_DATE 0x2u
+#define WW_DESCRIBE_DATE_RANGE 0x4u
+
+typedef struct {
+    size_t offset;
+    size_t length;
+} ww_span;
+
+/* Positions in `buf->ptr` of each output requested from ww_describe. Outputs
+ * that were not requested are left zeroed. */
+typedef struct {
+    ww_span timeago;
+    ww_span human_date;
+    ww_span date_range;
+} ww_description;
+
+bool ww_describe(ww_buf *buf, ww_escape_mode mode, ww_timestamp timestamp, ww_timestamp reference,
+                 ww_timestamp end, unsigned flags, ww_description *out);
+
+typedef enum {
+    WW_STEP_DAY,
+    WW_STEP_WEEK,
+    WW_STEP_MONTH
+} ww_calendar_step;
+
+/* Civil date in UTC. `days` counts days since 1970-01-01 and `weekday` is
+ * 0 for Sunday. */
+typedef struct {
+    int64_t days;
+    int32_t year;
+    uint8_t month;
+    uint8_t day;
+    uint8_t weekday;
+} ww_date;
+
+typedef struct {
+    ww_date current;
+    int64_t end_days;
+    ww_calendar_step step;
+    bool leap;
+} ww_calendar_iter;
+
+bool ww_calendar_iter_init(ww_calendar_iter *iter, ww_timestamp start, ww_timestamp end, ww_calendar_step step);
+bool ww_calendar_iter_next(ww_calendar_iter *iter, ww_date *out_first, ww_date *out_last, char *label,
+                           size_t label_size);
+
+bool parse_timeago(const char *input, ww_timestamp reference, double *out_lo, double *out_hi);
+
+/* Call capture, compiled in with -DWW_ENABLE_CAPTURE; otherwise
+ * ww_capture_start() returns false. See usage.md for the trace format. */
+typedef enum {
+    WW_CAPTURE_TIMEAGO = 1,
+    WW_CAPTURE_DURATION = 2,
+    WW_CAPTURE_HUMAN_DATE = 3,
+    WW_CAPTURE_DATE_RANGE = 4,
+    WW_CAPTURE_PARSE_DURATION = 5,
+    WW_CAPTURE_PARSE_DURATION_NS = 6,
+    WW_CAPTURE_PARSE_TIMEAGO = 7
+} ww_capture_op;
+
+#define WW_CAPTURE_MAGIC "WWCAP001"
+#define WW_CAPTURE_BYTE_ORDER 0x01020304u
+
+bool ww_capture_start(const char *path);
+bool ww_capture_flush(void);
+bool ww_capture_stop(void);
+uint64_t ww_capture_dropped(void);
 
 #ifdef __cplusplus
 }
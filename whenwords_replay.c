@@ -0,0 +1,343 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "whenwords.h"
+
+/* whenwords_replay: re-executes a trace written by ww_capture_start() against
+ * whichever whenwords.c it is linked with, and reports throughput and
+ * per-function latency. */
+
+#define REPLAY_OPS 8
+#define REPLAY_NULL_STRING 0xffffu
+
+static const char *const replay_op_names[REPLAY_OPS] = {
+    "?", "timeago", "duration", "human_date", "date_range", "parse_duration", "parse_duration_ns", "parse_timeago",
+};
+
+static const char *const replay_kind_names[] = {"unix", "iso", "tm", "unset"};
+
+typedef struct {
+    uint8_t op;
+    ww_escape_mode mode;
+    ww_timestamp first;
+    ww_timestamp second;
+    struct tm tms[2];
+    double seconds;
+    bool has_options;
+    ww_duration_options options;
+    const char *input;
+} replay_call;
+
+typedef struct {
+    const unsigned char *data;
+    size_t len;
+    size_t pos;
+    bool ok;
+} replay_reader;
+
+static void replay_read(replay_reader *reader, void *out, size_t len) {
+    if (!reader->ok || reader->len - reader->pos < len) {
+        reader->ok = false;
+        memset(out, 0, len);
+        return;
+    }
+    memcpy(out, reader->data + reader->pos, len);
+    reader->pos += len;
+}
+
+static unsigned replay_read_u8(replay_reader *reader) {
+    unsigned char byte = 0;
+    replay_read(reader, &byte, 1);
+    return byte;
+}
+
+/* Copies a string into the arena so it can be passed on NUL-terminated. */
+static const char *replay_read_string(replay_reader *reader, char **arena) {
+    uint16_t len = 0;
+    replay_read(reader, &len, sizeof(len));
+    if (!reader->ok || len == REPLAY_NULL_STRING) {
+        return NULL;
+    }
+    if (reader->len - reader->pos < len) {
+        reader->ok = false;
+        return NULL;
+    }
+    char *s = *arena;
+    memcpy(s, reader->data + reader->pos, len);
+    s[len] = '\0';
+    reader->pos += len;
+    *arena += len + 1;
+    return s;
+}
+
+static ww_timestamp replay_read_timestamp(replay_reader *reader, char **arena, struct tm *tm) {
+    unsigned kind = replay_read_u8(reader);
+    switch (kind) {
+    case WW_TS_UNIX: {
+        double seconds = 0.0;
+        replay_read(reader, &seconds, sizeof(seconds));
+        return ww_timestamp_from_unix(seconds);
+    }
+    case WW_TS_ISO:
+        return ww_timestamp_from_iso(replay_read_string(reader, arena));
+    case WW_TS_TM: {
+        if (!replay_read_u8(reader)) {
+            return ww_timestamp_from_tm(NULL);
+        }
+        int32_t fields[6];
+        replay_read(reader, fields, sizeof(fields));
+        memset(tm, 0, sizeof(*tm));
+        tm->tm_year = fields[0];
+        tm->tm_mon = fields[1];
+        tm->tm_mday = fields[2];
+        tm->tm_hour = fields[3];
+        tm->tm_min = fields[4];
+        tm->tm_sec = fields[5];
+        return ww_timestamp_from_tm(tm);
+    }
+    case WW_TS_NONE:
+        return ww_timestamp_unset();
+    default:
+        reader->ok = false;
+        return ww_timestamp_unset();
+    }
+}
+
+static bool replay_decode(const unsigned char *record, size_t len, char **arena, replay_call *call) {
+    replay_reader reader = {record, len, sizeof(uint16_t), true};
+    memset(call, 0, sizeof(*call));
+    call->op = (uint8_t)replay_read_u8(&reader);
+    call->mode = (ww_escape_mode)replay_read_u8(&reader);
+    switch (call->op) {
+    case WW_CAPTURE_TIMEAGO:
+    case WW_CAPTURE_HUMAN_DATE:
+    case WW_CAPTURE_DATE_RANGE:
+        call->first = replay_read_timestamp(&reader, arena, &call->tms[0]);
+        call->second = replay_read_timestamp(&reader, arena, &call->tms[1]);
+        break;
+    case WW_CAPTURE_DURATION:
+        replay_read(&reader, &call->seconds, sizeof(call->seconds));
+        call->has_options = replay_read_u8(&reader) != 0;
+        if (call->has_options) {
+            int32_t fields[2];
+            replay_read(&reader, fields, sizeof(fields));
+            call->options.compact = fields[0];
+            call->options.max_units = fields[1];
+        }
+        break;
+    case WW_CAPTURE_PARSE_DURATION:
+    case WW_CAPTURE_PARSE_DURATION_NS:
+        call->input = replay_read_string(&reader, arena);
+        break;
+    case WW_CAPTURE_PARSE_TIMEAGO:
+        call->input = replay_read_string(&reader, arena);
+        call->second = replay_read_timestamp(&reader, arena, &call->tms[1]);
+        break;
+    default:
+        return false;
+    }
+    return reader.ok && reader.pos == len;
+}
+
+static bool replay_execute(const replay_call *call, ww_buf *buf) {
+    buf->len = 0;
+    switch (call->op) {
+    case WW_CAPTURE_TIMEAGO:
+        return timeago_append(buf, call->mode, call->first, call->second);
+    case WW_CAPTURE_HUMAN_DATE:
+        return human_date_append(buf, call->mode, call->first, call->second);
+    case WW_CAPTURE_DATE_RANGE:
+        return date_range_append(buf, call->mode, call->first, call->second);
+    case WW_CAPTURE_DURATION:
+        return duration_append(buf, call->mode, call->seconds, call->has_options ? &call->options : NULL);
+    case WW_CAPTURE_PARSE_DURATION: {
+        double seconds;
+        return parse_duration(call->input, &seconds);
+    }
+    case WW_CAPTURE_PARSE_DURATION_NS: {
+        int64_t nanos;
+        return parse_duration_ns(call->input, &nanos);
+    }
+    case WW_CAPTURE_PARSE_TIMEAGO: {
+        double lo;
+        double hi;
+        return parse_timeago(call->input, call->second, &lo, &hi);
+    }
+    default:
+        return false;
+    }
+}
+
+static unsigned char *replay_load(const char *path, size_t *out_len) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    size_t cap = 1 << 16;
+    size_t len = 0;
+    unsigned char *data = (unsigned char *)malloc(cap);
+    while (data) {
+        len += fread(data + len, 1, cap - len, file);
+        if (len < cap) {
+            break;
+        }
+        cap *= 2;
+        unsigned char *grown = (unsigned char *)realloc(data, cap);
+        if (!grown) {
+            free(data);
+        }
+        data = grown;
+    }
+    fclose(file);
+    *out_len = len;
+    return data;
+}
+
+static double replay_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int replay_compare(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: %s trace.wwcap [iterations]\n", argv[0]);
+        return 2;
+    }
+    long iterations = argc == 3 ? strtol(argv[2], NULL, 10) : 10;
+    if (iterations < 1) {
+        iterations = 1;
+    }
+    size_t len = 0;
+    unsigned char *data = replay_load(argv[1], &len);
+    uint32_t byte_order = 0;
+    if (!data || len < 12 || memcmp(data, WW_CAPTURE_MAGIC, 8) != 0 ||
+        (memcpy(&byte_order, data + 8, sizeof(byte_order)), byte_order != WW_CAPTURE_BYTE_ORDER)) {
+        fprintf(stderr, "%s: not a whenwords trace from this architecture\n", argv[1]);
+        return 1;
+    }
+
+    size_t count = 0;
+    size_t pos = 12;
+    while (len - pos >= 2) {
+        uint16_t size;
+        memcpy(&size, data + pos, sizeof(size));
+        if (size < 4 || len - pos < size) {
+            break;
+        }
+        pos += size;
+        count++;
+    }
+    if (pos != len) {
+        fprintf(stderr, "%s: truncated record at byte %zu; replaying the first %zu calls\n", argv[1], pos, count);
+    }
+    replay_call *calls = (replay_call *)malloc((count ? count : 1) * sizeof(*calls));
+    char *arena_start = (char *)malloc(len + 2 * count + 1);
+    if (!calls || !arena_start) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    char *arena = arena_start;
+    size_t decoded = 0;
+    pos = 12;
+    for (size_t i = 0; i < count; i++) {
+        uint16_t size;
+        memcpy(&size, data + pos, sizeof(size));
+        if (replay_decode(data + pos, size, &arena, &calls[decoded])) {
+            decoded++;
+        }
+        pos += size;
+    }
+
+    size_t per_op[REPLAY_OPS] = {0};
+    size_t kinds[REPLAY_OPS][4] = {{0}};
+    size_t failures[REPLAY_OPS] = {0};
+    double *latencies[REPLAY_OPS] = {NULL};
+    for (size_t i = 0; i < decoded; i++) {
+        per_op[calls[i].op]++;
+        ww_timestamp ts = calls[i].op == WW_CAPTURE_PARSE_TIMEAGO ? calls[i].second : calls[i].first;
+        if (calls[i].op != WW_CAPTURE_DURATION && calls[i].op != WW_CAPTURE_PARSE_DURATION &&
+            calls[i].op != WW_CAPTURE_PARSE_DURATION_NS && (unsigned)ts.kind < 4) {
+            kinds[calls[i].op][ts.kind]++;
+        }
+    }
+    for (int op = 1; op < REPLAY_OPS; op++) {
+        latencies[op] = (double *)malloc((per_op[op] ? per_op[op] : 1) * sizeof(double));
+        if (!latencies[op]) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+    }
+
+    ww_buf buf = ww_buf_init(NULL, 0, realloc);
+    double start = replay_now();
+    for (long iteration = 0; iteration < iterations; iteration++) {
+        for (size_t i = 0; i < decoded; i++) {
+            replay_execute(&calls[i], &buf);
+        }
+    }
+    double elapsed = replay_now() - start;
+
+    /* Second pass timing each call; the cost of reading the clock is measured
+     * separately and subtracted. */
+    double overhead = replay_now();
+    for (int i = 0; i < 1000; i++) {
+        replay_now();
+    }
+    overhead = (replay_now() - overhead) / 1001.0;
+    size_t filled[REPLAY_OPS] = {0};
+    for (size_t i = 0; i < decoded; i++) {
+        uint8_t op = calls[i].op;
+        double before = replay_now();
+        bool ok = replay_execute(&calls[i], &buf);
+        double latency = replay_now() - before - overhead;
+        latencies[op][filled[op]++] = latency > 0.0 ? latency : 0.0;
+        failures[op] += !ok;
+    }
+
+    printf("%zu calls x %ld iterations: %.1f ns/call, %.2f Mcalls/s\n", decoded, iterations,
+           decoded ? elapsed * 1e9 / ((double)decoded * (double)iterations) : 0.0,
+           elapsed > 0.0 ? (double)decoded * (double)iterations / elapsed / 1e6 : 0.0);
+    printf("%-18s %9s %6s %8s %8s %8s %8s  %s\n", "function", "calls", "share", "failed", "mean ns", "p50 ns",
+           "p99 ns", "inputs");
+    for (int op = 1; op < REPLAY_OPS; op++) {
+        size_t n = per_op[op];
+        if (n == 0) {
+            continue;
+        }
+        double total = 0.0;
+        for (size_t i = 0; i < n; i++) {
+            total += latencies[op][i];
+        }
+        qsort(latencies[op], n, sizeof(double), replay_compare);
+        char mix[128] = "";
+        size_t used = 0;
+        for (int kind = 0; kind < 4; kind++) {
+            if (kinds[op][kind] > 0 && used < sizeof(mix)) {
+                used += (size_t)snprintf(mix + used, sizeof(mix) - used, "%s%s %.0f%%", used ? ", " : "",
+                                         replay_kind_names[kind], 100.0 * (double)kinds[op][kind] / (double)n);
+            }
+        }
+        printf("%-18s %9zu %5.1f%% %8zu %8.1f %8.1f %8.1f  %s\n", replay_op_names[op], n,
+               100.0 * (double)n / (double)decoded, failures[op], total / (double)n * 1e9,
+               latencies[op][n / 2] * 1e9, latencies[op][n * 99 / 100] * 1e9, mix);
+    }
+
+    for (int op = 0; op < REPLAY_OPS; op++) {
+        free(latencies[op]);
+    }
+    free(buf.ptr);
+    free(arena_start);
+    free(calls);
+    free(data);
+    return 0;
+}
@@ -0,0 +1,775 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "whenwords.h"
+#include "whenwordsd.h"
+
+/* whenwordsd: serves batched whenwords calls over a Unix socket so callers in
+ * other languages pay one round trip per batch instead of one FFI call per
+ * value. The main thread owns every connection and runs the epoll loop;
+ * workers only see jobs and hand results back through an eventfd. */
+
+#define WWD_MAX_FDS 4096
+#define WWD_MAX_EVENTS 64
+#define WWD_READ_CHUNK 65536
+#define WWD_COALESCE_BYTES (64u * 1024u)
+#define WWD_MAX_INFLIGHT 16
+#define WWD_MAX_UNSENT (4u * 1024u * 1024u)
+
+typedef struct {
+    unsigned char *ptr;
+    size_t len;
+    size_t cap;
+} wwd_bytes;
+
+static bool wwd_bytes_reserve(wwd_bytes *bytes, size_t extra) {
+    if (bytes->cap - bytes->len >= extra) {
+        return true;
+    }
+    size_t cap = bytes->cap ? bytes->cap : 4096;
+    while (cap - bytes->len < extra) {
+        cap *= 2;
+    }
+    unsigned char *ptr = (unsigned char *)realloc(bytes->ptr, cap);
+    if (!ptr) {
+        return false;
+    }
+    bytes->ptr = ptr;
+    bytes->cap = cap;
+    return true;
+}
+
+static bool wwd_bytes_append(wwd_bytes *bytes, const void *data, size_t len) {
+    if (!wwd_bytes_reserve(bytes, len)) {
+        return false;
+    }
+    memcpy(bytes->ptr + bytes->len, data, len);
+    bytes->len += len;
+    return true;
+}
+
+/* Consecutive frames from one connection, coalesced so a single worker
+ * handles them and the loop receives their responses in one piece. */
+typedef struct wwd_job {
+    struct wwd_job *next;
+    int fd;
+    uint32_t generation;
+    bool failed;
+    wwd_bytes frames;
+    wwd_bytes responses;
+} wwd_job;
+
+static void wwd_job_free(wwd_job *job) {
+    free(job->frames.ptr);
+    free(job->responses.ptr);
+    free(job);
+}
+
+typedef struct {
+    wwd_job *head;
+    wwd_job *tail;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    bool closed;
+} wwd_queue;
+
+static void wwd_queue_init(wwd_queue *queue) {
+    queue->head = NULL;
+    queue->tail = NULL;
+    queue->closed = false;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->ready, NULL);
+}
+
+static void wwd_queue_push(wwd_queue *queue, wwd_job *job) {
+    job->next = NULL;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->tail) {
+        queue->tail->next = job;
+    } else {
+        queue->head = job;
+    }
+    queue->tail = job;
+    pthread_cond_signal(&queue->ready);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/* Blocks until a job is available. Returns NULL once the queue is closed and
+ * drained. */
+static wwd_job *wwd_queue_pop(wwd_queue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    while (!queue->head && !queue->closed) {
+        pthread_cond_wait(&queue->ready, &queue->lock);
+    }
+    wwd_job *job = queue->head;
+    if (job) {
+        queue->head = job->next;
+        if (!queue->head) {
+            queue->tail = NULL;
+        }
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return job;
+}
+
+static wwd_job *wwd_queue_take_all(wwd_queue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    wwd_job *jobs = queue->head;
+    queue->head = NULL;
+    queue->tail = NULL;
+    pthread_mutex_unlock(&queue->lock);
+    return jobs;
+}
+
+static void wwd_queue_close(wwd_queue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = true;
+    pthread_cond_broadcast(&queue->ready);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/* Connection slots are indexed by fd. `generation` changes on close so a job
+ * finishing after its connection went away is dropped rather than delivered
+ * to a new connection that reused the fd. */
+typedef struct {
+    bool open;
+    bool draining;
+    uint32_t generation;
+    uint32_t events;
+    size_t inflight;
+    size_t out_sent;
+    wwd_bytes in;
+    wwd_bytes out;
+} wwd_conn;
+
+typedef struct {
+    int epoll_fd;
+    int listen_fd;
+    int wake_fd;
+    wwd_conn *conns;
+    wwd_queue pending;
+    wwd_queue done;
+} wwd_server;
+
+/* Per-worker scratch, grown on demand and reused across frames. */
+typedef struct {
+    wwd_server *server;
+    ww_buf text;
+    size_t capacity;
+    ww_packed_ts *values;
+    size_t *offsets;
+    int32_t *offsets32;
+    uint8_t *validity;
+    char *string;
+    size_t string_capacity;
+} wwd_worker;
+
+static bool wwd_worker_reserve(wwd_worker *worker, size_t count) {
+    if (count < worker->capacity) {
+        return true;
+    }
+    size_t capacity = worker->capacity ? worker->capacity : 1024;
+    while (capacity <= count) {
+        capacity *= 2;
+    }
+    ww_packed_ts *values = (ww_packed_ts *)realloc(worker->values, capacity * sizeof(*values));
+    if (!values) {
+        return false;
+    }
+    worker->values = values;
+    size_t *offsets = (size_t *)realloc(worker->offsets, capacity * sizeof(*offsets));
+    if (!offsets) {
+        return false;
+    }
+    worker->offsets = offsets;
+    int32_t *offsets32 = (int32_t *)realloc(worker->offsets32, capacity * sizeof(*offsets32));
+    if (!offsets32) {
+        return false;
+    }
+    worker->offsets32 = offsets32;
+    uint8_t *validity = (uint8_t *)realloc(worker->validity, capacity / 8 + 1);
+    if (!validity) {
+        return false;
+    }
+    worker->validity = validity;
+    worker->capacity = capacity;
+    return true;
+}
+
+static bool wwd_worker_reserve_string(wwd_worker *worker, size_t size) {
+    if (size <= worker->string_capacity) {
+        return true;
+    }
+    char *string = (char *)realloc(worker->string, size);
+    if (!string) {
+        return false;
+    }
+    worker->string = string;
+    worker->string_capacity = size;
+    return true;
+}
+
+/* Appends one response item; a NULL `data` marks a rejected input. */
+static bool wwd_put_item(wwd_bytes *out, const void *data, size_t len) {
+    if (!wwd_bytes_reserve(out, 4 + (data ? len : 0))) {
+        return false;
+    }
+    wwd_put_u32(out->ptr + out->len, data ? (uint32_t)len : WWD_NULL_ITEM);
+    out->len += 4;
+    if (data) {
+        memcpy(out->ptr + out->len, data, len);
+        out->len += len;
+    }
+    return true;
+}
+
+static wwd_status wwd_run_timestamps(wwd_worker *worker, uint8_t op, ww_escape_mode mode, ww_packed_ts reference,
+                                     const unsigned char *body, size_t count, wwd_bytes *out) {
+    if (!wwd_worker_reserve(worker, count)) {
+        return WWD_STATUS_NO_MEMORY;
+    }
+    for (size_t i = 0; i < count; i++) {
+        worker->values[i] = wwd_get_f64(body + 8 * i);
+    }
+    bool ok = op == WWD_OP_TIMEAGO
+                  ? timeago_batch(&worker->text, mode, worker->values, count, reference, worker->offsets)
+                  : human_date_batch(&worker->text, mode, worker->values, count, reference, worker->offsets);
+    if (!ok) {
+        return WWD_STATUS_NO_MEMORY;
+    }
+    for (size_t i = 0; i < count; i++) {
+        size_t len = worker->offsets[i + 1] - worker->offsets[i];
+        if (!wwd_put_item(out, len ? worker->text.ptr + worker->offsets[i] : NULL, len)) {
+            return WWD_STATUS_NO_MEMORY;
+        }
+    }
+    return WWD_STATUS_OK;
+}
+
+static wwd_status wwd_run_duration(wwd_worker *worker, uint8_t compact, uint8_t max_units,
+                                   const unsigned char *body, size_t count, wwd_bytes *out) {
+    if (!wwd_worker_reserve(worker, count)) {
+        return WWD_STATUS_NO_MEMORY;
+    }
+    for (size_t i = 0; i < count; i++) {
+        worker->values[i] = wwd_get_f64(body + 8 * i);
+    }
+    ww_duration_options options = ww_duration_options_default();
+    options.compact = compact;
+    if (max_units > 0) {
+        options.max_units = max_units;
+    }
+    ww_column column = ww_column_from_double(worker->values, NULL, count);
+    if (!duration_column(&column, &options, &worker->text, worker->offsets32, worker->validity)) {
+        return WWD_STATUS_NO_MEMORY;
+    }
+    for (size_t i = 0; i < count; i++) {
+        bool valid = (worker->validity[i / 8] >> (i % 8)) & 1u;
+        size_t len = (size_t)(worker->offsets32[i + 1] - worker->offsets32[i]);
+        if (!wwd_put_item(out, valid ? worker->text.ptr + worker->offsets32[i] : NULL, len)) {
+            return WWD_STATUS_NO_MEMORY;
+        }
+    }
+    return WWD_STATUS_OK;
+}
+
+static wwd_status wwd_run_date_range(wwd_worker *worker, ww_escape_mode mode, const unsigned char *body,
+                                     size_t count, wwd_bytes *out) {
+    if (!wwd_worker_reserve(worker, 2 * count)) {
+        return WWD_STATUS_NO_MEMORY;
+    }
+    ww_packed_ts *starts = worker->values;
+    ww_packed_ts *ends = worker->values + count;
+    for (size_t i = 0; i < count; i++) {
+        starts[i] = wwd_get_f64(body + 16 * i);
+        ends[i] = wwd_get_f64(body + 16 * i + 8);
+    }
+    if (!date_range_batch(&worker->text, mode, starts, ends, count, worker->offsets)) {
+        return WWD_STATUS_NO_MEMORY;
+    }
+    for (size_t i = 0; i < count; i++) {
+        size_t len = worker->offsets[i + 1] - worker->offsets[i];
+        if (!wwd_put_item(out, len ? worker->text.ptr + worker->offsets[i] : NULL, len)) {
+            return WWD_STATUS_NO_MEMORY;
+        }
+    }
+    return WWD_STATUS_OK;
+}
+
+static wwd_status wwd_run_parse_duration(wwd_worker *worker, const unsigned char *body, size_t body_len,
+                                         size_t count, wwd_bytes *out) {
+    size_t pos = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (body_len - pos < 4) {
+            return WWD_STATUS_BAD_REQUEST;
+        }
+        size_t len = wwd_get_u32(body + pos);
+        pos += 4;
+        if (body_len - pos < len) {
+            return WWD_STATUS_BAD_REQUEST;
+        }
+        if (!wwd_worker_reserve_string(worker, len + 1)) {
+            return WWD_STATUS_NO_MEMORY;
+        }
+        memcpy(worker->string, body + pos, len);
+        worker->string[len] = '\0';
+        pos += len;
+        double seconds = 0.0;
+        unsigned char item[8];
+        bool ok = strlen(worker->string) == len && parse_duration(worker->string, &seconds);
+        if (ok) {
+            wwd_put_f64(item, seconds);
+        }
+        if (!wwd_put_item(out, ok ? item : NULL, sizeof(item))) {
+            return WWD_STATUS_NO_MEMORY;
+        }
+    }
+    return pos == body_len ? WWD_STATUS_OK : WWD_STATUS_BAD_REQUEST;
+}
+
+static wwd_status wwd_run_op(wwd_worker *worker, const unsigned char *frame, size_t size, wwd_bytes *out) {
+    uint8_t op = frame[8];
+    size_t count = wwd_get_u32(frame + 12);
+    const unsigned char *body = frame + WWD_HEADER_SIZE;
+    size_t body_len = size - WWD_HEADER_SIZE;
+    if (frame[9] > WW_ESCAPE_HTML) {
+        return WWD_STATUS_BAD_REQUEST;
+    }
+    ww_escape_mode mode = (ww_escape_mode)frame[9];
+    worker->text.len = 0;
+    switch (op) {
+    case WWD_OP_TIMEAGO:
+    case WWD_OP_HUMAN_DATE:
+        if (body_len < 8 || (body_len - 8) % 8 != 0 || (body_len - 8) / 8 != count) {
+            return WWD_STATUS_BAD_REQUEST;
+        }
+        return wwd_run_timestamps(worker, op, mode, wwd_get_f64(body), body + 8, count, out);
+    case WWD_OP_DURATION:
+        if (body_len % 8 != 0 || body_len / 8 != count) {
+            return WWD_STATUS_BAD_REQUEST;
+        }
+        return wwd_run_duration(worker, frame[10], frame[11], body, count, out);
+    case WWD_OP_DATE_RANGE:
+        if (body_len % 16 != 0 || body_len / 16 != count) {
+            return WWD_STATUS_BAD_REQUEST;
+        }
+        return wwd_run_date_range(worker, mode, body, count, out);
+    case WWD_OP_PARSE_DURATION:
+        return wwd_run_parse_duration(worker, body, body_len, count, out);
+    default:
+        return WWD_STATUS_BAD_REQUEST;
+    }
+}
+
+/* Writes the response to one frame. A failed request is answered with its
+ * status and no items. Returns false only if the header itself cannot be
+ * allocated. */
+static bool wwd_run_frame(wwd_worker *worker, const unsigned char *frame, size_t size, wwd_bytes *out) {
+    if (!wwd_bytes_reserve(out, WWD_HEADER_SIZE)) {
+        return false;
+    }
+    size_t header = out->len;
+    out->len += WWD_HEADER_SIZE;
+    uint32_t count = wwd_get_u32(frame + 12);
+    wwd_status status = wwd_run_op(worker, frame, size, out);
+    if (status != WWD_STATUS_OK) {
+        out->len = header + WWD_HEADER_SIZE;
+        count = 0;
+    }
+    unsigned char *p = out->ptr + header;
+    wwd_put_u32(p, (uint32_t)(out->len - header - 4));
+    memcpy(p + 4, frame + 4, 4);
+    p[8] = frame[8];
+    p[9] = (unsigned char)status;
+    p[10] = 0;
+    p[11] = 0;
+    wwd_put_u32(p + 12, count);
+    return true;
+}
+
+static void *wwd_worker_main(void *arg) {
+    wwd_worker *worker = (wwd_worker *)arg;
+    wwd_job *job;
+    while ((job = wwd_queue_pop(&worker->server->pending)) != NULL) {
+        size_t pos = 0;
+        while (pos < job->frames.len && !job->failed) {
+            const unsigned char *frame = job->frames.ptr + pos;
+            size_t size = (size_t)wwd_get_u32(frame) + 4;
+            job->failed = !wwd_run_frame(worker, frame, size, &job->responses);
+            pos += size;
+        }
+        wwd_queue_push(&worker->server->done, job);
+        uint64_t one = 1;
+        ssize_t written = write(worker->server->wake_fd, &one, sizeof(one));
+        (void)written;
+    }
+    return NULL;
+}
+
+static void wwd_conn_close(wwd_server *server, int fd) {
+    wwd_conn *conn = &server->conns[fd];
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+    free(conn->in.ptr);
+    free(conn->out.ptr);
+    uint32_t generation = conn->generation + 1;
+    memset(conn, 0, sizeof(*conn));
+    conn->generation = generation;
+}
+
+/* True while the connection may take on more work: fewer jobs than the
+ * in-flight limit and less unsent output than WWD_MAX_UNSENT, so a client
+ * that writes without reading stalls instead of growing `out`. */
+static bool wwd_conn_accepting(const wwd_conn *conn) {
+    return conn->inflight < WWD_MAX_INFLIGHT && conn->out.len - conn->out_sent < WWD_MAX_UNSENT;
+}
+
+/* Queues every complete buffered frame while the connection is accepting.
+ * Returns false on a malformed length, after which the stream cannot be
+ * resynced. */
+static bool wwd_conn_dispatch(wwd_server *server, int fd) {
+    wwd_conn *conn = &server->conns[fd];
+    wwd_job *job = NULL;
+    size_t pos = 0;
+    bool ok = true;
+    while (wwd_conn_accepting(conn) && conn->in.len - pos >= 4) {
+        uint32_t length = wwd_get_u32(conn->in.ptr + pos);
+        if (length < WWD_HEADER_SIZE - 4 || length > WWD_MAX_FRAME) {
+            ok = false;
+            break;
+        }
+        size_t size = (size_t)length + 4;
+        if (conn->in.len - pos < size) {
+            break;
+        }
+        if (!job) {
+            job = (wwd_job *)calloc(1, sizeof(*job));
+            if (!job) {
+                ok = false;
+                break;
+            }
+            job->fd = fd;
+            job->generation = conn->generation;
+        }
+        if (!wwd_bytes_append(&job->frames, conn->in.ptr + pos, size)) {
+            ok = false;
+            break;
+        }
+        pos += size;
+        if (job->frames.len >= WWD_COALESCE_BYTES) {
+            wwd_queue_push(&server->pending, job);
+            conn->inflight++;
+            job = NULL;
+        }
+    }
+    if (job && ok) {
+        wwd_queue_push(&server->pending, job);
+        conn->inflight++;
+    } else if (job) {
+        wwd_job_free(job);
+    }
+    memmove(conn->in.ptr, conn->in.ptr + pos, conn->in.len - pos);
+    conn->in.len -= pos;
+    return ok;
+}
+
+static bool wwd_conn_read(wwd_server *server, int fd) {
+    wwd_conn *conn = &server->conns[fd];
+    if (conn->draining) {
+        return true;
+    }
+    if (!wwd_bytes_reserve(&conn->in, WWD_READ_CHUNK)) {
+        return false;
+    }
+    ssize_t n;
+    do {
+        n = read(fd, conn->in.ptr + conn->in.len, conn->in.cap - conn->in.len);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    if (n == 0) {
+        conn->draining = true;
+    }
+    conn->in.len += (size_t)n;
+    return true;
+}
+
+static bool wwd_conn_flush(wwd_server *server, int fd) {
+    wwd_conn *conn = &server->conns[fd];
+    while (conn->out_sent < conn->out.len) {
+        ssize_t n = send(fd, conn->out.ptr + conn->out_sent, conn->out.len - conn->out_sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            conn->out_sent += (size_t)n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+    }
+    conn->out.len = 0;
+    conn->out_sent = 0;
+    return true;
+}
+
+/* Flushes what can be sent and dispatches buffered frames, then either
+ * closes the connection or re-arms epoll: reads pause while the connection
+ * is not accepting, and writes are watched only while output is pending. */
+static void wwd_conn_settle(wwd_server *server, int fd, bool ok) {
+    wwd_conn *conn = &server->conns[fd];
+    if (ok) {
+        ok = wwd_conn_flush(server, fd) && wwd_conn_dispatch(server, fd);
+    }
+    if (!ok || (conn->draining && conn->inflight == 0 && conn->out.len == 0)) {
+        wwd_conn_close(server, fd);
+        return;
+    }
+    uint32_t events = 0;
+    if (!conn->draining && wwd_conn_accepting(conn)) {
+        events |= EPOLLIN;
+    }
+    if (conn->out.len > 0) {
+        events |= EPOLLOUT;
+    }
+    if (events != conn->events) {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = events;
+        event.data.fd = fd;
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, fd, &event);
+        conn->events = events;
+    }
+}
+
+static void wwd_deliver(wwd_server *server) {
+    uint64_t wakeups;
+    ssize_t n = read(server->wake_fd, &wakeups, sizeof(wakeups));
+    (void)n;
+    wwd_job *job = wwd_queue_take_all(&server->done);
+    while (job) {
+        wwd_job *next = job->next;
+        wwd_conn *conn = &server->conns[job->fd];
+        if (conn->open && conn->generation == job->generation) {
+            conn->inflight--;
+            bool ok = !job->failed;
+            if (ok && conn->out.len == 0) {
+                wwd_bytes swap = conn->out;
+                conn->out = job->responses;
+                job->responses = swap;
+            } else if (ok) {
+                ok = wwd_bytes_append(&conn->out, job->responses.ptr, job->responses.len);
+            }
+            wwd_conn_settle(server, job->fd, ok);
+        }
+        wwd_job_free(job);
+        job = next;
+    }
+}
+
+static void wwd_accept(wwd_server *server) {
+    for (;;) {
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        if (fd >= WWD_MAX_FDS) {
+            close(fd);
+            continue;
+        }
+        wwd_conn *conn = &server->conns[fd];
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            close(fd);
+            continue;
+        }
+        conn->open = true;
+        conn->events = EPOLLIN;
+    }
+}
+
+static int wwd_listen(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "whenwordsd: socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("whenwordsd: socket");
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        perror("whenwordsd: bind");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool wwd_watch(wwd_server *server, int fd) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    return epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+static volatile sig_atomic_t wwd_stopping;
+
+static void wwd_on_signal(int signo) {
+    (void)signo;
+    wwd_stopping = 1;
+}
+
+static void wwd_run(wwd_server *server) {
+    struct epoll_event events[WWD_MAX_EVENTS];
+    while (!wwd_stopping) {
+        int n = epoll_wait(server->epoll_fd, events, WWD_MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("whenwordsd: epoll_wait");
+            return;
+        }
+        ww_clock_refresh();
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == server->listen_fd) {
+                wwd_accept(server);
+            } else if (fd == server->wake_fd) {
+                wwd_deliver(server);
+            } else if (server->conns[fd].open) {
+                uint32_t ready = events[i].events;
+                bool ok = !(ready & (EPOLLERR | EPOLLHUP));
+                if (ok && (ready & EPOLLIN)) {
+                    ok = wwd_conn_read(server, fd);
+                }
+                wwd_conn_settle(server, fd, ok);
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *path = WWD_DEFAULT_SOCKET;
+    long workers = sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+    while ((opt = getopt(argc, argv, "s:w:")) != -1) {
+        switch (opt) {
+        case 's':
+            path = optarg;
+            break;
+        case 'w':
+            workers = strtol(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s socket] [-w workers]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (workers < 1) {
+        workers = 1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = wwd_on_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    wwd_server server;
+    memset(&server, 0, sizeof(server));
+    wwd_queue_init(&server.pending);
+    wwd_queue_init(&server.done);
+    server.conns = (wwd_conn *)calloc(WWD_MAX_FDS, sizeof(*server.conns));
+    wwd_worker *pool = (wwd_worker *)calloc((size_t)workers, sizeof(*pool));
+    pthread_t *threads = (pthread_t *)calloc((size_t)workers, sizeof(*threads));
+    if (!server.conns || !pool || !threads) {
+        fprintf(stderr, "whenwordsd: out of memory\n");
+        return 1;
+    }
+    server.listen_fd = wwd_listen(path);
+    if (server.listen_fd < 0) {
+        return 1;
+    }
+    server.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    server.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (server.epoll_fd < 0 || server.wake_fd < 0 || !wwd_watch(&server, server.listen_fd) ||
+        !wwd_watch(&server, server.wake_fd)) {
+        perror("whenwordsd: epoll");
+        return 1;
+    }
+
+    /* A NaN reference means "now"; refreshing once per loop iteration gives
+     * every frame in a wakeup the same clock reading. */
+    ww_clock_set_mode(WW_CLOCK_CACHED);
+    ww_clock_refresh();
+
+    for (long i = 0; i < workers; i++) {
+        pool[i].server = &server;
+        pool[i].text = ww_buf_init(NULL, 0, realloc);
+        if (pthread_create(&threads[i], NULL, wwd_worker_main, &pool[i]) != 0) {
+            fprintf(stderr, "whenwordsd: cannot start worker %ld\n", i);
+            return 1;
+        }
+    }
+    fprintf(stderr, "whenwordsd: listening on %s with %ld workers\n", path, workers);
+
+    wwd_run(&server);
+
+    wwd_queue_close(&server.pending);
+    for (long i = 0; i < workers; i++) {
+        pthread_join(threads[i], NULL);
+        free(pool[i].text.ptr);
+        free(pool[i].values);
+        free(pool[i].offsets);
+        free(pool[i].offsets32);
+        free(pool[i].validity);
+        free(pool[i].string);
+    }
+    wwd_job *job = wwd_queue_take_all(&server.done);
+    while (job) {
+        wwd_job *next = job->next;
+        wwd_job_free(job);
+        job = next;
+    }
+    for (int fd = 0; fd < WWD_MAX_FDS; fd++) {
+        if (server.conns[fd].open) {
+            wwd_conn_close(&server, fd);
+        }
+    }
+    close(server.listen_fd);
+    close(server.wake_fd);
+    close(server.epoll_fd);
+    unlink(path);
+    free(threads);
+    free(pool);
+    free(server.conns);
+    return 0;
+}
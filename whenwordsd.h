@@ -0,0 +1,71 @@
+#ifndef WHENWORDSD_H
+#define WHENWORDSD_H
+
+/* Wire format shared by whenwordsd and whenwordsd_load.
+ *
+ * Every frame starts with a 16-byte header. Integers are big-endian and
+ * doubles travel as their IEEE 754 bit pattern in a u64. `length` counts the
+ * bytes that follow it, so a whole frame is `length + 4` bytes.
+ *
+ *   request:  u32 length | u32 id | u8 op | u8 mode | u8 compact | u8 max_units | u32 count | body
+ *   response: u32 length | u32 id | u8 op | u8 status | u16 zero  | u32 count   | items
+ *
+ * Request bodies, by op:
+ *   TIMEAGO, HUMAN_DATE: f64 reference, then `count` f64 timestamps
+ *   DURATION:            `count` f64 seconds (`compact`/`max_units` apply)
+ *   DATE_RANGE:          `count` pairs of f64 start, f64 end
+ *   PARSE_DURATION:      `count` strings, each u32 length then bytes
+ *
+ * A NaN timestamp is unset; a NaN reference means the daemon's clock. Each
+ * response item is a u32 length then bytes, or WWD_NULL_ITEM for an input the
+ * library rejected. PARSE_DURATION items are 8-byte f64 seconds. Responses
+ * carry the request id and may arrive out of order on a pipelined connection. */
+
+#include <stdint.h>
+#include <string.h>
+
+#define WWD_DEFAULT_SOCKET "/tmp/whenwordsd.sock"
+#define WWD_HEADER_SIZE 16
+#define WWD_MAX_FRAME (16u * 1024u * 1024u)
+#define WWD_NULL_ITEM 0xffffffffu
+
+typedef enum {
+    WWD_OP_TIMEAGO = 1,
+    WWD_OP_HUMAN_DATE = 2,
+    WWD_OP_DURATION = 3,
+    WWD_OP_DATE_RANGE = 4,
+    WWD_OP_PARSE_DURATION = 5
+} wwd_op;
+
+typedef enum {
+    WWD_STATUS_OK = 0,
+    WWD_STATUS_BAD_REQUEST = 1,
+    WWD_STATUS_NO_MEMORY = 2
+} wwd_status;
+
+static inline void wwd_put_u32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static inline uint32_t wwd_get_u32(const unsigned char *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline void wwd_put_f64(unsigned char *p, double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    wwd_put_u32(p, (uint32_t)(bits >> 32));
+    wwd_put_u32(p + 4, (uint32_t)bits);
+}
+
+static inline double wwd_get_f64(const unsigned char *p) {
+    uint64_t bits = ((uint64_t)wwd_get_u32(p) << 32) | wwd_get_u32(p + 4);
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+#endif
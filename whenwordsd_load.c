@@ -0,0 +1,405 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "whenwordsd.h"
+
+/* whenwordsd_load: drives whenwordsd with pipelined batches from several
+ * connections and reports throughput and per-frame latency. */
+
+#define LOAD_REFERENCE 1704067200.0
+#define LOAD_MAX_DEPTH 65535u
+
+static const char *const load_durations[] = {
+    "1h30m", "2 hours 15 minutes", "2h 30m", "1:30:00", "90s", "1.5h", "3 days", "45 min",
+};
+
+typedef struct {
+    const char *path;
+    wwd_op op;
+    size_t batch;
+    size_t depth;
+    double seconds;
+} load_config;
+
+typedef struct {
+    const load_config *config;
+    unsigned seed;
+    bool failed;
+    uint64_t frames;
+    uint64_t items;
+    uint64_t nulls;
+    uint64_t errors;
+    double *latencies;
+    size_t latency_count;
+    size_t latency_cap;
+} load_thread;
+
+static double load_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static bool load_write_all(int fd, const unsigned char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool load_read_all(int fd, unsigned char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = read(fd, data, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static int load_connect(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static size_t load_body_size(const load_config *config) {
+    switch (config->op) {
+    case WWD_OP_TIMEAGO:
+    case WWD_OP_HUMAN_DATE:
+        return 8 + 8 * config->batch;
+    case WWD_OP_DATE_RANGE:
+        return 16 * config->batch;
+    case WWD_OP_PARSE_DURATION: {
+        size_t size = 0;
+        for (size_t i = 0; i < config->batch; i++) {
+            size += 4 + strlen(load_durations[i % (sizeof(load_durations) / sizeof(load_durations[0]))]);
+        }
+        return size;
+    }
+    default:
+        return 8 * config->batch;
+    }
+}
+
+/* Builds one request frame with random inputs; only the id changes between
+ * sends. */
+static unsigned char *load_build_frame(load_thread *thread, size_t *out_size) {
+    const load_config *config = thread->config;
+    size_t size = WWD_HEADER_SIZE + load_body_size(config);
+    unsigned char *frame = (unsigned char *)calloc(1, size);
+    if (!frame) {
+        return NULL;
+    }
+    wwd_put_u32(frame, (uint32_t)(size - 4));
+    frame[8] = (unsigned char)config->op;
+    wwd_put_u32(frame + 12, (uint32_t)config->batch);
+    unsigned char *p = frame + WWD_HEADER_SIZE;
+    if (config->op == WWD_OP_TIMEAGO || config->op == WWD_OP_HUMAN_DATE) {
+        wwd_put_f64(p, LOAD_REFERENCE);
+        p += 8;
+    }
+    for (size_t i = 0; i < config->batch; i++) {
+        double age = (double)(rand_r(&thread->seed) % (3 * 365 * 86400));
+        switch (config->op) {
+        case WWD_OP_DATE_RANGE:
+            wwd_put_f64(p, LOAD_REFERENCE - age);
+            wwd_put_f64(p + 8, LOAD_REFERENCE - age + (double)(rand_r(&thread->seed) % (60 * 86400)));
+            p += 16;
+            break;
+        case WWD_OP_PARSE_DURATION: {
+            const char *s = load_durations[i % (sizeof(load_durations) / sizeof(load_durations[0]))];
+            size_t len = strlen(s);
+            wwd_put_u32(p, (uint32_t)len);
+            memcpy(p + 4, s, len);
+            p += 4 + len;
+            break;
+        }
+        case WWD_OP_DURATION:
+            wwd_put_f64(p, age);
+            p += 8;
+            break;
+        default:
+            wwd_put_f64(p, LOAD_REFERENCE - age);
+            p += 8;
+            break;
+        }
+    }
+    *out_size = size;
+    return frame;
+}
+
+static bool load_record(load_thread *thread, double latency) {
+    if (thread->latency_count == thread->latency_cap) {
+        size_t cap = thread->latency_cap ? thread->latency_cap * 2 : 4096;
+        double *latencies = (double *)realloc(thread->latencies, cap * sizeof(*latencies));
+        if (!latencies) {
+            return false;
+        }
+        thread->latencies = latencies;
+        thread->latency_cap = cap;
+    }
+    thread->latencies[thread->latency_count++] = latency;
+    return true;
+}
+
+/* Counts items in a response and checks that they exactly fill the frame. */
+static bool load_check_items(load_thread *thread, const unsigned char *items, size_t len, uint32_t count) {
+    size_t pos = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (len - pos < 4) {
+            return false;
+        }
+        uint32_t item = wwd_get_u32(items + pos);
+        pos += 4;
+        if (item == WWD_NULL_ITEM) {
+            thread->nulls++;
+        } else if (len - pos < item) {
+            return false;
+        } else {
+            pos += item;
+        }
+    }
+    return pos == len;
+}
+
+/* Keeps `depth` frames in flight. The low 16 bits of each id name the slot
+ * holding its send time, so out-of-order responses are timed correctly. */
+static void *load_run(void *arg) {
+    load_thread *thread = (load_thread *)arg;
+    const load_config *config = thread->config;
+    size_t frame_size = 0;
+    unsigned char *frame = load_build_frame(thread, &frame_size);
+    double *sent = (double *)calloc(config->depth, sizeof(*sent));
+    unsigned char *response = NULL;
+    size_t response_cap = 0;
+    int fd = load_connect(config->path);
+    if (!frame || !sent || fd < 0) {
+        thread->failed = true;
+        goto done;
+    }
+
+    uint32_t sequence = 0;
+    size_t outstanding = 0;
+    double deadline = load_now() + config->seconds;
+    for (size_t slot = 0; slot < config->depth; slot++) {
+        wwd_put_u32(frame + 4, (sequence++ << 16) | (uint32_t)slot);
+        sent[slot] = load_now();
+        if (!load_write_all(fd, frame, frame_size)) {
+            thread->failed = true;
+            goto done;
+        }
+        outstanding++;
+    }
+    while (outstanding > 0) {
+        unsigned char header[WWD_HEADER_SIZE];
+        if (!load_read_all(fd, header, sizeof(header))) {
+            thread->failed = true;
+            break;
+        }
+        size_t body = (size_t)wwd_get_u32(header) + 4 - WWD_HEADER_SIZE;
+        if (body > response_cap) {
+            unsigned char *grown = (unsigned char *)realloc(response, body);
+            if (!grown) {
+                thread->failed = true;
+                break;
+            }
+            response = grown;
+            response_cap = body;
+        }
+        if (!load_read_all(fd, response, body)) {
+            thread->failed = true;
+            break;
+        }
+        size_t slot = wwd_get_u32(header + 4) & 0xffffu;
+        double now = load_now();
+        uint32_t count = wwd_get_u32(header + 12);
+        outstanding--;
+        thread->frames++;
+        if (slot >= config->depth || !load_record(thread, now - sent[slot]) ||
+            !load_check_items(thread, response, body, count)) {
+            thread->failed = true;
+            break;
+        }
+        if (header[9] != WWD_STATUS_OK) {
+            thread->errors++;
+        }
+        thread->items += count;
+        if (now < deadline) {
+            wwd_put_u32(frame + 4, (sequence++ << 16) | (uint32_t)slot);
+            sent[slot] = now;
+            if (!load_write_all(fd, frame, frame_size)) {
+                thread->failed = true;
+                break;
+            }
+            outstanding++;
+        }
+    }
+
+done:
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(response);
+    free(sent);
+    free(frame);
+    return NULL;
+}
+
+static int load_compare(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static bool load_parse_op(const char *name, wwd_op *out) {
+    static const struct {
+        const char *name;
+        wwd_op op;
+    } ops[] = {
+        {"timeago", WWD_OP_TIMEAGO},
+        {"human_date", WWD_OP_HUMAN_DATE},
+        {"duration", WWD_OP_DURATION},
+        {"date_range", WWD_OP_DATE_RANGE},
+        {"parse_duration", WWD_OP_PARSE_DURATION},
+    };
+    for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        if (strcmp(name, ops[i].name) == 0) {
+            *out = ops[i].op;
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char **argv) {
+    load_config config = {WWD_DEFAULT_SOCKET, WWD_OP_TIMEAGO, 256, 8, 5.0};
+    const char *op_name = "timeago";
+    long connections = 4;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:o:c:d:b:t:")) != -1) {
+        switch (opt) {
+        case 's':
+            config.path = optarg;
+            break;
+        case 'o':
+            op_name = optarg;
+            break;
+        case 'c':
+            connections = strtol(optarg, NULL, 10);
+            break;
+        case 'd':
+            config.depth = (size_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'b':
+            config.batch = (size_t)strtoul(optarg, NULL, 10);
+            break;
+        case 't':
+            config.seconds = strtod(optarg, NULL);
+            break;
+        default:
+            op_name = NULL;
+            break;
+        }
+    }
+    if (!op_name || !load_parse_op(op_name, &config.op) || connections < 1 || config.depth < 1 ||
+        config.depth > LOAD_MAX_DEPTH || config.batch < 1) {
+        fprintf(stderr,
+                "usage: %s [-s socket] [-o timeago|human_date|duration|date_range|parse_duration]\n"
+                "          [-c connections] [-d depth] [-b batch] [-t seconds]\n",
+                argv[0]);
+        return 2;
+    }
+
+    load_thread *threads = (load_thread *)calloc((size_t)connections, sizeof(*threads));
+    pthread_t *ids = (pthread_t *)calloc((size_t)connections, sizeof(*ids));
+    if (!threads || !ids) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    double start = load_now();
+    for (long i = 0; i < connections; i++) {
+        threads[i].config = &config;
+        threads[i].seed = (unsigned)(42 + i);
+        if (pthread_create(&ids[i], NULL, load_run, &threads[i]) != 0) {
+            fprintf(stderr, "cannot start client thread\n");
+            return 1;
+        }
+    }
+    load_thread total;
+    memset(&total, 0, sizeof(total));
+    for (long i = 0; i < connections; i++) {
+        pthread_join(ids[i], NULL);
+        total.failed = total.failed || threads[i].failed;
+        total.frames += threads[i].frames;
+        total.items += threads[i].items;
+        total.nulls += threads[i].nulls;
+        total.errors += threads[i].errors;
+        for (size_t j = 0; j < threads[i].latency_count; j++) {
+            if (!load_record(&total, threads[i].latencies[j])) {
+                total.failed = true;
+            }
+        }
+        free(threads[i].latencies);
+    }
+    double elapsed = load_now() - start;
+
+    printf("%s: %ld connections x depth %zu, batch %zu, %.1f s\n", op_name, connections, config.depth,
+           config.batch, elapsed);
+    printf("%12.0f frames/s %14.0f items/s %10.1f ns/item\n", (double)total.frames / elapsed,
+           (double)total.items / elapsed, total.items ? elapsed * 1e9 / (double)total.items : 0.0);
+    printf("%12llu frames %16llu items %12llu null %8llu errors\n", (unsigned long long)total.frames,
+           (unsigned long long)total.items, (unsigned long long)total.nulls, (unsigned long long)total.errors);
+    if (total.latency_count > 0) {
+        qsort(total.latencies, total.latency_count, sizeof(double), load_compare);
+        printf("frame latency: p50 %.1f us, p99 %.1f us, max %.1f us\n",
+               total.latencies[total.latency_count / 2] * 1e6,
+               total.latencies[total.latency_count * 99 / 100] * 1e6,
+               total.latencies[total.latency_count - 1] * 1e6);
+    }
+    free(total.latencies);
+    free(ids);
+    free(threads);
+    if (total.failed) {
+        fprintf(stderr, "connection to %s failed\n", config.path);
+        return 1;
+    }
+    return 0;
+}